@@ -0,0 +1,11 @@
+#!/bin/bash
+# Regression checks of nfp-estimator features on the programs of the paper
+
+set -e
+
+PROGDIR="${PROGDIR:-"data-paper/programs/"}"
+
+set -x
+
+# loop summaries of a loop writing packet memory
+./build/nfp-estimator -F loop-summary -U 160 -w 5 -c 1 -T 600 -f "$PROGDIR/xdp-alaw2ulaw.asm" -o /dev/null
@@ -7,6 +7,7 @@ BUILD_TARGETS= $(patsubst %,$(BUILD_DIR)/%, \
 	statistics \
 	nfp-estimator \
 	bpf \
+	libnfpestimator.a \
 )
 
 read_OBJS = \
@@ -54,8 +55,14 @@ nfp-estimator_OBJS = \
 	$(BUILD_DIR)/estimator/instr.tab.o \
 	$(BUILD_DIR)/estimator/instr.lex.o \
 	$(BUILD_DIR)/estimator/cfg.o \
+	$(BUILD_DIR)/estimator/spill.o \
 	$(BUILD_DIR)/estimator/thread_pool.o
 
+# link with -lrt -lcrypto -lstdc++ -lpthread
+libnfpestimator_OBJS = \
+	$(nfp-estimator_OBJS) \
+	$(BUILD_DIR)/estimator/estimator.o
+
 bpf_LDLIBS = -lelf -lbfd -lopcodes -lz -liberty -ldl -lstdc++
 bpf_OBJS = \
 	$(BUILD_DIR)/ereport.o \
@@ -9,14 +9,19 @@ bool mem_available();
 
 #include <memory>
 #include <thread>
+#include <mutex>
 #include <atomic>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <list>
 #include <stack>
 #include <queue>
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <optional>
 #include <iterator>
 #include <algorithm>
@@ -24,27 +29,44 @@ bool mem_available();
 #include <iostream>
 #include <fstream>
 #include <chrono>
+#include <iomanip>
 #include <limits>
 #include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
 #include <typeinfo>
+#include <exception>
+#include <stdexcept>
 #include <err.h>
-
-
-unsigned int cfg::COST_FIRMWARE = 224;
-double cfg::DRAM_COST_FIRMWARE = 0.0;
-std::size_t cfg::PARALLELISM = std::thread::hardware_concurrency();
-std::size_t cfg::UNROLL_LIMIT = 0;
-std::map<std::uint32_t,std::size_t> cfg::UNROLL_LIMITS = {};
-std::uint32_t cfg::MIN_PACKETSIZE = 60;
-std::uint32_t cfg::MTU = 1500;
-unsigned int cfg::NUM_WORKERS = 50;
-std::uint32_t cfg::PACKET_HEADROOM = 1<<31;
+#include <unistd.h>
+#include <openssl/sha.h>
+
+
+thread_local unsigned int cfg::COST_FIRMWARE = 224;
+thread_local double cfg::DRAM_COST_FIRMWARE = 0.0;
+thread_local std::size_t cfg::PARALLELISM = std::thread::hardware_concurrency();
+thread_local std::size_t cfg::UNROLL_LIMIT = 0;
+thread_local std::map<std::uint32_t,std::size_t> cfg::UNROLL_LIMITS = {};
+thread_local std::uint32_t cfg::MIN_PACKETSIZE = 60;
+thread_local std::uint32_t cfg::MTU = 1500;
+thread_local unsigned int cfg::NUM_WORKERS = 50;
+thread_local std::uint32_t cfg::PACKET_HEADROOM = 1<<31;
+thread_local unsigned int cfg::CHECKPOINT_INTERVAL = 60;
+thread_local unsigned int cfg::CLOCK_FREQUENCY = 800000000;
 
 auto o_impossible_prefixes     = features::flag("impossible-prefixes", true);
 auto o_check_each_branch       = features::flag("check-each-branch", false);
 auto o_check_unlikely_edges    = features::flag("check-unlikely-edges", false);
 auto o_impossible_path_merging = features::flag("impossible-path-merging", true);
 auto o_keep_impossible_paths   = features::flag("keep-impossible-paths", true);
+auto o_loop_summary            = features::flag("loop-summary", false);
+auto o_feasible_path_merging   = features::flag("feasible-path-merging", false);
+auto o_k_longest_paths         = features::flag("k-longest-paths", false);
+auto o_spill_paths             = features::flag("spill-paths", true);
+
+// diverging assumptions plus ifthenelse terms a merge of feasible paths may add
+static constexpr std::size_t MERGE_BUDGET = 16;
 
 struct node_data;
 
@@ -76,7 +98,8 @@ public:
 		std::tuple<_d<path::MAX_CYCLES>,_d<path::DRAM_CYCLES>> td = {};
 	};
 private:
-	std::vector<std::shared_ptr<const instr>> instructions;
+	// shared between the iterations of an unrolled loop
+	std::shared_ptr<std::vector<std::shared_ptr<const instr>>> instructions;
 	succ_data successor_false = {};
 	succ_data successor_true = {};
 	std::vector<pred_data> predecessors = {};
@@ -92,16 +115,16 @@ private:
 
 public:
 	node(std::shared_ptr<const instr> n)
-		: instructions({n}) {}
-	node(const std::vector<std::shared_ptr<const instr>> ns)
+		: instructions(std::make_shared<std::vector<std::shared_ptr<const instr>>>(1, n)) {}
+	node(std::shared_ptr<std::vector<std::shared_ptr<const instr>>> ns)
 		: instructions(ns) {}
 
 	std::vector<std::shared_ptr<const instr>>& instrs() {
-		return this->instructions;
+		return *this->instructions;
 	}
 
 	std::uint32_t id() const {
-		return this->instructions.front()->get_id();
+		return this->instructions->front()->get_id();
 	}
 
 	std::size_t loopdepth() const {
@@ -114,15 +137,15 @@ public:
 	}
 
 	std::uint32_t next_id() const {
-		return this->instructions.back()->get_id() + 1;
+		return this->instructions->back()->get_id() + 1;
 	}
 
 	std::uint32_t br_id() const {
-		return std::static_pointer_cast<const instr::branch>(this->instructions.back())->br_target();
+		return std::static_pointer_cast<const instr::branch>(this->instructions->back())->br_target();
 	}
 
 	enum instr::type exit_type() const {
-		return this->instructions.back()->type();
+		return this->instructions->back()->type();
 	}
 
 	std::size_t indegree() const {
@@ -219,8 +242,10 @@ public:
 	}
 
 	void merge_node(nptr nd) {
-		this->instructions.insert(this->instructions.end(), nd->instructions.begin(), nd->instructions.end());
-		nd->instructions.clear();
+		if (this->instructions.use_count() > 1)
+			this->instructions = std::make_shared<std::vector<std::shared_ptr<const instr>>>(*this->instructions);
+		this->instructions->insert(this->instructions->end(), nd->instructions->begin(), nd->instructions->end());
+		nd->instructions = std::make_shared<std::vector<std::shared_ptr<const instr>>>();
 		this->successor_true = nd->successor_true;
 		this->successor_false = nd->successor_false;
 		if (this->successor_true) {
@@ -235,6 +260,7 @@ public:
 		}
 	}
 
+	// an iteration only references the instructions of its base node
 	nptr clone(std::size_t depth) const {
 		nptr c = std::make_shared<cfg::node>(this->instructions);
 		for (auto s: this->succ())
@@ -262,6 +288,15 @@ public:
 		return r;
 	}
 
+	template<typename S>
+	pathq::sizet mqsize(bool branchtrue, std::uint32_t s) const {
+		if (branchtrue && this->successor_true)
+			return this->successor_true.mq(S{}).size(s);
+		if (!branchtrue && this->successor_false)
+			return this->successor_false.mq(S{}).size(s);
+		return 0;
+	}
+
 	template<typename S>
 	mpathq mqtake(bool branchtrue) {
 		if (branchtrue && this->successor_true) {
@@ -455,6 +490,10 @@ public:
 		: s(w->s),
 		  minpacketsize(w->min_packetsize()),
 		  state(w->state) {}
+	withstate(const withstate<state::exec>& a, const withstate<state::exec>& b, const S& state)
+		: s(a.s),
+		  minpacketsize(std::min(a.minpacketsize, b.minpacketsize)),
+		  state(state) {}
 
 	const S& get_state() const {
 		return this->state;
@@ -527,7 +566,7 @@ public:
 		  count(count) {}
 	impossible(withstate<state::exec>* w)
 		: withstate(w),
-		  count(1) {}
+		  count(w->size()) {}
 
 	std::string str() const override {
 		return "(" + std::to_string(this->count) + ")";
@@ -589,22 +628,32 @@ private:
 	pptr as_impossible = nullptr;
 	bool branchtrue;
 	std::atomic<bool> marked_unsat = false;
+	// number of feasible paths merged into this one
+	std::size_t count = 1;
 
 public:
-	possible(std::shared_ptr<cfg::path::possible> pred, const succ_data& s, std::uint32_t min_packetsize, const class state::exec& state, bool branchtrue)
+	possible(std::shared_ptr<cfg::path::possible> pred, const succ_data& s, std::uint32_t min_packetsize, const class state::exec& state, bool branchtrue, std::size_t count=1)
 		: withstate(s, min_packetsize, state),
 		  pred(pred),
-		  branchtrue(branchtrue) {}
+		  branchtrue(branchtrue),
+		  count(count) {}
+	possible(const possible& a, const possible& b, const class state::exec& state)
+		: withstate(a, b, state),
+		  pred(a.pred),
+		  branchtrue(a.branchtrue),
+		  count(a.count + b.count) {}
 
 	std::string str() const override {
 		std::string s;
 		for (auto p = shared_from_this(); p; p = p->pred)
 			s = (p->branchtrue ? "->" : "--") + std::to_string(p->s.nd->id()) + s;
+		if (this->count > 1)
+			s += "(" + std::to_string(this->count) + ")";
 		return s;
 	}
 
 	std::size_t size() const override {
-		return 1;
+		return this->count;
 	}
 
 	std::uint32_t min_packetsize() const override {
@@ -643,6 +692,12 @@ public:
 		return this->as_impossible;
 	}
 
+	// checked satisfiable by the run resumed from, with this minimum packet size
+	pptr settle(std::uint32_t min_packetsize) {
+		this->state.assume_minimized(true, min_packetsize);
+		return shared_from_this();
+	}
+
 	pptr extendn(bool branchtrue) override {
 		if (this->marked_unsat)
 			return to_impossible()->extend(branchtrue);
@@ -652,13 +707,13 @@ public:
 		state.apply(*i.n, i.i, this->s.nd->loopdepth(), branchtrue);
 		auto& s = this->s.nd->succ(branchtrue);
 		if (state.is_unsat())
-			return std::make_shared<path::impossible>(s, min_packetsize(), state);
+			return std::make_shared<path::impossible>(s, min_packetsize(), state, this->count);
 		if (may_satcheck(branchtrue) && !state.check_sat(o_impossible_prefixes)) {
 			apply_unsat_core(state, branchtrue);
-			return std::make_shared<path::impossible>(s, min_packetsize(), state);
+			return std::make_shared<path::impossible>(s, min_packetsize(), state, this->count);
 		}
 
-		return std::make_shared<path::possible>(shared_from_this(), s, min_packetsize(), state, branchtrue);
+		return std::make_shared<path::possible>(shared_from_this(), s, min_packetsize(), state, branchtrue, this->count);
 	}
 
 	pptr check() override {
@@ -716,21 +771,139 @@ public:
 		}
 	}
 
+	/* Only merges into a path that dominates this one, so the merged path
+	 * keeps the position of o in the queue and its bounds. */
+	pptr merge(pptr o) const override {
+		if (!o_feasible_path_merging)
+			return nullptr;
+		std::shared_ptr<possible> p = std::dynamic_pointer_cast<possible>(o);
+		if (!p || &p->s != &this->s || p->marked_unsat || this->marked_unsat)
+			return nullptr;
+		if (max_cycles() > p->max_cycles() || dram_cycles() > p->dram_cycles() || min_packetsize() < p->min_packetsize())
+			return nullptr;
+
+		static stats::counter s_merged_paths("cfg.merged-paths");
+
+		std::optional<class state::exec> state = p->state.path_merge(this->state, MERGE_BUDGET);
+		if (!state)
+			return nullptr;
+		auto m = std::make_shared<path::possible>(*p, *this, *state);
+		if (m->min_packetsize() < p->min_packetsize())
+			return nullptr;
+		s_merged_paths.count();
+		return m;
+	}
+
+	// merged paths cannot be replayed and are kept in memory
+	pptr evict(class spill& tier) override;
+};
+
+static stats::counter& s_spilled_paths() {
+	static stats::counter s("cfg.spilled-paths");
+	return s;
+}
+
+/* A possible path evicted to the spill tier. Only the branches taken from
+ * the start and its description are stored, neither its state nor its
+ * predecessors are kept. It is replayed from the start once it is
+ * extended or checked, which may then turn out unsat due to sat checks
+ * enabled in the meantime. */
+class cfg::path::spilled : public withstate<state::perf>, public std::enable_shared_from_this<cfg::path::spilled> {
+private:
+	class spill& tier;
+	spill::handle h;
+	std::shared_ptr<possible> start;
+
+	// the branches, a newline and the description of the path
+	pptr restore() const {
+		std::string r = this->tier.get(this->h);
+		r.erase(r.find('\n'));
+		pptr p = this->start;
+		for (char b: r) {
+			if (auto pp = std::dynamic_pointer_cast<possible>(p)) {
+				p = pp->extendn(b == '1');
+			} else {
+				p = p->extend(b == '1');
+			}
+		}
+		return p;
+	}
+public:
+	spilled(possible* p, std::shared_ptr<possible> start, class spill& tier, spill::handle h)
+		: withstate(p),
+		  tier(tier),
+		  h(h),
+		  start(start) {
+		s_spilled_paths().count();
+	}
+	~spilled() {
+		this->tier.release(this->h);
+		s_spilled_paths().down();
+	}
+
+	std::string str() const override {
+		std::string r = this->tier.get(this->h);
+		return r.substr(r.find('\n')+1);
+	}
+
+	std::size_t size() const override {
+		return 1;
+	}
+
+	bool is_none() const override {
+		return false;
+	}
+
+	bool is_decided() const override {
+		return false;
+	}
+
+	bool is_unsat() const override {
+		return false;
+	}
+
+	bool may_satcheck(bool branchtrue) const override {
+		return this->s.nd->sat_check_enabled(branchtrue);
+	}
+
+	bool is_same(pptr o) const override {
+		return shared_from_this() == o;
+	}
+
+	pptr extendn(bool branchtrue) override {
+		return restore()->extend(branchtrue);
+	}
+
+	pptr check() override {
+		return restore()->check();
+	}
+
 	pptr merge(pptr o) const override {
 		return nullptr;
 	}
 };
 
+cfg::pptr cfg::path::possible::evict(class spill& tier) {
+	if (this->count > 1 || this->marked_unsat)
+		return nullptr;
+	std::string branches;
+	auto p = shared_from_this();
+	for (; p->pred; p = p->pred)
+		branches.push_back(p->branchtrue ? '1' : '0');
+	std::reverse(branches.begin(), branches.end());
+	return std::make_shared<spilled>(this, p, tier, tier.put(branches + "\n" + str()));
+}
+
 const cfg::pathq::sizet cfg::pathq::sizet::MAX = std::numeric_limits<std::size_t>::max();
 
 cfg::pathq::pathq(std::initializer_list<pptr> l)
-	: paths(l) {
+	: paths(std::deque<pptr>(l)) {
 	for (const pptr p: l)
 		this->count += p->size();
 }
 
 cfg::pathq::pathq(const pptr& p)
-	: paths({p}),
+	: paths(std::deque<pptr>({p})),
 	  count(p->size()) {};
 
 void cfg::pathq::swap(pathq& o) {
@@ -742,38 +915,47 @@ cfg::pathq::sizet cfg::pathq::size() const {
 	return this->count;
 }
 
+const std::deque<cfg::pptr>& cfg::pathq::queue() const {
+	static const std::deque<pptr> none;
+	return this->paths ? *this->paths : none;
+}
+
 auto cfg::pathq::begin() const {
-	return this->paths.begin();
+	return queue().begin();
 }
 
 auto cfg::pathq::end() const {
-	return this->paths.end();
+	return queue().end();
 }
 
 cfg::pptr cfg::pathq::front() const {
-	if (this->paths.empty())
+	if (queue().empty())
 		return nullptr;
-	return this->paths.front();
+	return this->paths->front();
 }
 
 cfg::pptr cfg::pathq::back() const {
-	if (this->paths.empty())
+	if (queue().empty())
 		return nullptr;
-	return this->paths.back();
+	return this->paths->back();
 }
 
 void cfg::pathq::push(const pathq& q) {
 	this->count += q.size();
-	auto b = q.paths.begin();
-	if (this->paths.size() && q.paths.size()) {
-		pptr m = q.paths.front()->merge(this->paths.back());
+	if (q.queue().empty())
+		return;
+	if (!this->paths)
+		this->paths.emplace();
+	auto b = q.paths->begin();
+	if (this->paths->size()) {
+		pptr m = q.paths->front()->merge(this->paths->back());
 		if (m) {
-			this->paths.pop_back();
-			this->paths.push_back(m);
+			this->paths->pop_back();
+			this->paths->push_back(m);
 			b++;
 		}
 	}
-	this->paths.insert(this->paths.end(), b, q.paths.end());
+	this->paths->insert(this->paths->end(), b, q.paths->end());
 }
 
 void cfg::pathq::push(pathq&& q) {
@@ -783,32 +965,55 @@ void cfg::pathq::push(pathq&& q) {
 	}
 
 	this->count += q.size();
-	auto b = q.paths.begin();
-	if (this->paths.size() && q.paths.size()) {
-		pptr m = q.paths.front()->merge(this->paths.back());
+	if (q.queue().empty())
+		return;
+	if (!this->paths)
+		this->paths.emplace();
+	auto b = q.paths->begin();
+	if (this->paths->size()) {
+		pptr m = q.paths->front()->merge(this->paths->back());
 		if (m) {
-			this->paths.pop_back();
-			this->paths.push_back(m);
+			this->paths->pop_back();
+			this->paths->push_back(m);
 			b++;
 		}
 	}
-	this->paths.insert(this->paths.end(), std::make_move_iterator(b), std::make_move_iterator(q.paths.end()));
+	this->paths->insert(this->paths->end(), std::make_move_iterator(b), std::make_move_iterator(q.paths->end()));
 }
 
 cfg::pptr cfg::pathq::take() {
-	if (this->paths.empty())
+	if (queue().empty())
 		return nullptr;
-	pptr p = this->paths.front();
-	this->paths.pop_front();
+	pptr p = this->paths->front();
+	this->paths->pop_front();
 	this->count -= p->size();
 	if (this->count == sizet::MAX) {
 		this->count = 0;
-		for (const pptr i: this->paths)
+		for (const pptr i: *this->paths)
 			this->count += i->size();
 	}
+	// a drained queue gives its blocks back
+	if (this->paths->empty())
+		this->paths.reset();
 	return p;
 }
 
+// copy of the queue with the paths behind the first from ones evicted
+cfg::pathq cfg::pathq::evict(class spill& tier, sizet from) const {
+	pathq r;
+	r.count = this->count;
+	if (queue().empty())
+		return r;
+	r.paths.emplace();
+	sizet i = 0;
+	for (const pptr& p: *this->paths) {
+		pptr e = i < from ? nullptr : p->evict(tier);
+		r.paths->push_back(e ? e : p);
+		i += p->size();
+	}
+	return r;
+}
+
 class cfg::mpathq::sizev::intersection {
 private:
 	class iterator {
@@ -1225,6 +1430,16 @@ public:
 		}
 	}
 
+	/* no path of the size class will exceed its bound, so the class does not
+	 * hold back paths above it and is only pulled once the limit drops */
+	void bound(const std::vector<tratio<S>>& bounds) {
+		for (auto& b: bounds) {
+			auto i = this->sizes.find(b.size);
+			if (i != this->sizes.end() && b < i->second)
+				i->second = b;
+		}
+	}
+
 	std::optional<std::pair<pptr,std::uint32_t>> front() const {
 		auto f = this->q.begin();
 		if (f == this->q.end() || f->first < this->limit)
@@ -1551,21 +1766,215 @@ public:
 	}
 };
 
+/* Recursive enumeration of the k longest paths (Jimenez and Marzal) over the
+ * edges of the loop-free cfg. The i-th longest suffix of an edge is a
+ * deviation to one successor edge combined with some longest suffix there,
+ * so the suffix lists are shared by all prefixes reaching an edge and each
+ * further path costs one heap operation per edge on it. Weights are the
+ * increase of S by extending a path, they do not depend on the prefix as
+ * instructions are costed with their overestimated state::perf::info. */
+template<typename S>
+class cfg::kpaths {
+	using value_t = typename S::value_type;
+	struct suffix {
+		value_t value;
+		bool branchtrue;
+		std::size_t next; // index into the suffixes of the successor edge
+		bool operator < (const suffix& o) const {
+			return this->value < o.value;
+		}
+	};
+	struct edge {
+		bool expanded = false;
+		value_t weight[2] = {};
+		std::vector<suffix> suffixes = {};
+		std::vector<suffix> candidates = {};
+	};
+
+	// a trie over the branches taken, marking the prefixes known to be unsat
+	struct prefix {
+		std::size_t next[2] = {0, 0};
+		bool unsat = false;
+	};
+
+	cfg& g;
+	pptr start;
+	std::unordered_map<const succ_data*,edge> edges = {};
+	std::size_t taken = 0;
+	std::vector<prefix> unsat = {prefix()};
+
+	void candidate(edge& e, const succ_data* s, bool branchtrue, std::size_t next) {
+		const succ_data* n = &s->nd->succ(branchtrue);
+		if (!suffixes(n, next))
+			return;
+		e.candidates.push_back({e.weight[branchtrue] + this->edges[n].suffixes[next].value, branchtrue, next});
+		std::push_heap(e.candidates.begin(), e.candidates.end());
+	}
+
+	// makes sure s has a suffix with index i
+	bool suffixes(const succ_data* s, std::size_t i) {
+		edge& e = this->edges[s];
+		while (e.suffixes.size() <= i) {
+			if (!e.expanded) {
+				e.expanded = true;
+				if (s->nd == this->g.fin_nd) {
+					e.suffixes.push_back({value_t(), true, 0});
+					continue;
+				}
+				for (auto [n, branchtrue]: s->nd->succ()) {
+					e.weight[branchtrue] = cfg::weight<S>(*s, branchtrue);
+					candidate(e, s, branchtrue, 0);
+				}
+			} else if (s->nd != this->g.fin_nd) {
+				const suffix l = e.suffixes.back();
+				candidate(e, s, l.branchtrue, l.next+1);
+			}
+			if (e.candidates.empty())
+				return false;
+			std::pop_heap(e.candidates.begin(), e.candidates.end());
+			e.suffixes.push_back(e.candidates.back());
+			e.candidates.pop_back();
+		}
+		return true;
+	}
+
+	// branches taken by the i-th longest path
+	std::vector<bool> branches(std::size_t i) {
+		std::vector<bool> b;
+		const succ_data* s = &this->g.start;
+		while (s->nd != this->g.fin_nd) {
+			const suffix& x = this->edges[s].suffixes[i];
+			b.push_back(x.branchtrue);
+			s = &s->nd->succ(x.branchtrue);
+			i = x.next;
+		}
+		return b;
+	}
+
+	// whether a prefix of the branches is known to be unsat
+	bool pruned(const std::vector<bool>& b) const {
+		std::size_t n = 0;
+		for (bool branchtrue: b) {
+			n = this->unsat[n].next[branchtrue];
+			if (!n)
+				return false;
+			if (this->unsat[n].unsat)
+				return true;
+		}
+		return false;
+	}
+
+	void prune(const std::vector<bool>& b, std::size_t length) {
+		std::size_t n = 0;
+		for (std::size_t d = 0; d < length; d++) {
+			if (!this->unsat[n].next[b[d]]) {
+				std::size_t c = this->unsat.size();
+				this->unsat.push_back(prefix());
+				this->unsat[n].next[b[d]] = c;
+			}
+			n = this->unsat[n].next[b[d]];
+			if (this->unsat[n].unsat)
+				return;
+		}
+		this->unsat[n].unsat = true;
+	}
+
+	/* Extends the paths edge by edge. Extending is not thread-safe for
+	 * shared prefixes, so one task per prefix extends it for all paths
+	 * sharing it, and the tasks of an edge run in parallel. Paths found
+	 * unsat stop there and their prefix is pruned. */
+	std::vector<pptr> materialize(const std::vector<std::vector<bool>>& paths) {
+		std::vector<pptr> p(paths.size(), this->start);
+		for (std::size_t d = 0;; d++) {
+			std::map<const path*,std::vector<std::size_t>> prefixes;
+			for (std::size_t i = 0; i < paths.size(); i++) {
+				if (p[i] && d < paths[i].size())
+					prefixes[p[i].get()].push_back(i);
+			}
+			if (prefixes.empty())
+				return p;
+			thread_pool::group group(this->g.thread_pool);
+			for (auto& [prefix, is]: prefixes) {
+				group.delegate([&p,&paths,&is=is,d] {
+					pptr x[2] = {};
+					for (std::size_t i: is) {
+						bool branchtrue = paths[i][d];
+						if (!x[branchtrue])
+							x[branchtrue] = p[i]->extend(branchtrue);
+						p[i] = x[branchtrue];
+					}
+				});
+			}
+			group.wait();
+			for (std::size_t i = 0; i < paths.size(); i++) {
+				if (p[i] && d < paths[i].size() && p[i]->is_unsat()) {
+					prune(paths[i], d+1);
+					p[i] = nullptr;
+				}
+			}
+		}
+	}
+
+public:
+	kpaths(cfg& g, pptr start)
+		: g(g),
+		  start(start) {}
+
+	// paths with a prefix known to be unsat are skipped without extending them again
+	pathq next(std::size_t k) {
+		static stats::counter s_deviations("cfg.kpaths.deviations");
+		static stats::counter s_pruned("cfg.kpaths.pruned");
+		pathq q;
+		while (q.size() < k) {
+			std::vector<std::vector<bool>> paths;
+			bool exhausted = false;
+			while (q.size() + paths.size() < k) {
+				if (!suffixes(&this->g.start, this->taken)) {
+					exhausted = true;
+					break;
+				}
+				auto b = branches(this->taken++);
+				s_deviations.count();
+				if (pruned(b)) {
+					s_pruned.count();
+					continue;
+				}
+				paths.push_back(std::move(b));
+			}
+			for (auto& p: materialize(paths)) {
+				if (p)
+					q.push(pathq(p));
+			}
+			if (exhausted) {
+				q.push(pathq(std::make_shared<path::none>()));
+				break;
+			}
+		}
+		return q;
+	}
+};
+
 template<typename... S>
 class cfg::itpathq {
 	rmax<S...> limits;
 
-	template<typename V> using next_t = std::function<mpathq(std::size_t)>;
+	template<typename V> using next_t = std::function<mpathq(const mpathq::sizev&)>;
+	using guard_t = std::function<void(const std::function<void()>&)>;
 	template<typename V>
-	void pull_(std::size_t k, const next_t<V>& next_k) {
-		push<V>(next_k(k));
+	void pull_(std::size_t k, const guard_t& guard, const next_t<V>& next_k) {
+		mpathq::sizev sizes;
+		guard([&] { sizes = std::get<tpathq<V>>(this->tqs).sizes_to(k); });
+		mpathq mq = next_k(sizes);
+		guard([&] { push<V>(mq); });
 	}
 	template<typename V0, typename V1, typename... V>
-	void pull_(std::size_t k, const next_t<V0>& next_k0, const next_t<V1>& next_k1, const next_t<V>&... next_k) {
-		if (typeid(V0) == this->limits.type()) {
-			pull_<V0>(k, next_k0);
+	void pull_(std::size_t k, const guard_t& guard, const next_t<V0>& next_k0, const next_t<V1>& next_k1, const next_t<V>&... next_k) {
+		bool first;
+		guard([&] { first = typeid(V0) == this->limits.type(); });
+		if (first) {
+			pull_<V0>(k, guard, next_k0);
 		} else {
-			pull_<V1,V...>(k, next_k1, next_k...);
+			pull_<V1,V...>(k, guard, next_k1, next_k...);
 		}
 	}
 
@@ -1688,8 +2097,10 @@ public:
 		: limits(limits),
 		  tqs(tpathq<S>(sizes)...) {}
 
-	void pull(std::size_t k, const next_t<S>&... next_k) {
-		pull_<S...>(k, next_k...);
+	/* only the queue updates run under the guard, extending paths may
+	 * overlap with completions working on the queue */
+	void pull(std::size_t k, const guard_t& guard, const next_t<S>&... next_k) {
+		pull_<S...>(k, guard, next_k...);
 	};
 
 	auto front() const {
@@ -1709,6 +2120,11 @@ public:
 		return std::get<tpathq<V>>(this->tqs).sizes_to(k);
 	}
 
+	template<typename V>
+	void bound(const std::vector<tratio<V>>& bounds) {
+		std::get<tpathq<V>>(this->tqs).bound(bounds);
+	}
+
 	void adjust_size(pptr p, pptr c) {
 		return adjust_size_<S...>(p, c, vmax<S...>(S{}(p)...).type());
 	}
@@ -1719,12 +2135,18 @@ class cfg::itpathq<S> : public cfg::tpathq<S> {
 public:
 	itpathq(const mpathq::sizev& sizes, const rmax<S>&)
 		: tpathq<S>(sizes) {}
-	void pull(std::size_t k, const std::function<mpathq(std::size_t k)>& next_k) {
-		((tpathq<S>*) this)->push(next_k(k));
+	void pull(std::size_t k, const std::function<void(const std::function<void()>&)>& guard, const std::function<mpathq(const mpathq::sizev&)>& next_k) {
+		mpathq::sizev sizes;
+		guard([&] { sizes = ((const tpathq<S>*) this)->sizes_to(k); });
+		mpathq mq = next_k(sizes);
+		guard([&] { ((tpathq<S>*) this)->push(mq); });
 	}
 	template<typename V> mpathq::sizev sizes_to(std::size_t k) const {
 		return ((const tpathq<V>*) this)->sizes_to(k);
 	}
+	template<typename V> void bound(const std::vector<tratio<V>>& bounds) {
+		((tpathq<V>*) this)->bound(bounds);
+	}
 };
 
 template<typename S>
@@ -1808,51 +2230,18 @@ state::exec cfg::initial_state() {
 
 template<typename S>
 auto cfg::underestimate_packetrate() {
-	std::map<nptr,path::iptr> map;
-	map[this->start.nd] = std::make_shared<path::impossible>(this->start, MIN_PACKETSIZE, initial_state());
-
-	for (nptr nd: this->nodes) {
-		path::iptr p = map[nd];
-		for (auto& [sd,branchtrue]: nd->succ()) {
-			path::iptr n = p->extendi(branchtrue);
-			path::iptr& e = map[sd.get().nd];
-			if (!e || S{}(e) < S{}(n))
-				e = n;
-		}
-	}
-
-	path::iptr& m = map[this->fin_nd];
-	return S{}(m);
+	path::iptr start = std::make_shared<path::impossible>(this->start, MIN_PACKETSIZE, initial_state());
+	return S{}(start) + this->start.d<S>().suffix;
 }
 
 template<typename S>
 auto cfg::underestimate_bitrate(const mpathq::sizev& sizes) {
-	std::map<std::pair<nptr,std::uint32_t>, path::iptr> map;
-	path::iptr start = std::make_shared<path::impossible>(this->start, MIN_PACKETSIZE, initial_state());
-	for (auto [s,ss]: sizes)
-		map[std::make_pair(this->start.nd,s)] = start;
-
-	for (nptr nd: this->nodes) {
-		for (auto& [sd,branchtrue]: nd->succ()) {
-			for (auto [s, ss]: sd.get().sizes) {
-				path::iptr n = map[std::make_pair(nd,s)]->extendi(branchtrue);
-				path::iptr& m = map[std::make_pair(sd.get().nd,s)];
-				if (!m || S{}(m) < S{}(n))
-					m = n;
-			}
-		}
-	}
-
-	path::iptr m;
-	std::uint32_t ms;
-	for (auto [s,ss]: sizes) {
-		path::iptr& e = map[std::make_pair(this->fin_nd, s)];
-		if (!m || S{}(m, ms) < S{}(e, s)) {
-			m = e;
-			ms = s;
-		}
+	tratio<S> m = tratio<S>::MIN;
+	for (auto& b: suffix_bounds<S>(sizes)) {
+		if (m < b)
+			m = b;
 	}
-	return tratio<S>(m,ms);
+	return m;
 }
 
 template<typename S>
@@ -1887,8 +2276,8 @@ cfg::pathq cfg::next_k(std::size_t k) {
 						q.push(px);
 				}, p->may_satcheck(m->branchtrue));
 			}
-			this->thread_pool.wait();
-			e.pr->nd->template qpush<S>(!e.pr->branchtrue, q);
+			ordered.wait();
+			e.pr->nd->template qpush<S>(!e.pr->branchtrue, evict(q, e.pr->nd->template qsize<S>(!e.pr->branchtrue), e.k));
 			e.pr->q(S{}).push(std::move(q));
 			if (stack.empty())
 				return output.front().q(S{});
@@ -1933,8 +2322,8 @@ cfg::mpathq cfg::next_k(const mpathq::sizev& k) {
 							q.push(px);
 					}, p->may_satcheck(m->branchtrue));
 				}
-				this->thread_pool.wait();
-				e.pr->nd->template mqpush<S>(!e.pr->branchtrue, q, s);
+				ordered.wait();
+				e.pr->nd->template mqpush<S>(!e.pr->branchtrue, evict(q, e.pr->nd->template mqsize<S>(!e.pr->branchtrue, s), sk), s);
 				e.pr->mq(S{}).push(std::move(q), s);
 			}
 			if (stack.empty())
@@ -1946,6 +2335,15 @@ cfg::mpathq cfg::next_k(const mpathq::sizev& k) {
 	}
 }
 
+/* Paths waiting for the other branch of a node stay queued until that
+ * branch is pulled again. Under memory pressure those further than hot
+ * paths back in the queue are spilled and replayed once pulled. */
+cfg::pathq cfg::evict(const pathq& q, pathq::sizet ahead, pathq::sizet hot) {
+	if (!this->spilling)
+		return q;
+	return q.evict(this->spill, hot - ahead);
+}
+
 template<typename S>
 void cfg::push_impossible() {
 	for (nptr nd: this->nodes) {
@@ -1988,28 +2386,136 @@ void cfg::push_mimpossible() {
 	}
 }
 
+static std::string json_number(double v) {
+	if (!std::isfinite(v))
+		return "null";
+	std::ostringstream s;
+	s << std::setprecision(12) << v;
+	return s.str();
+}
+
+// throughput of the slower of the processors and the DRAM for a cost per packet or byte
+static double packetrate(double cycles, double dram_cycles) {
+	double r = std::numeric_limits<double>::infinity();
+	if (cycles > 0)
+		r = std::min(r, 1.0 * cfg::CLOCK_FREQUENCY * cfg::NUM_WORKERS / cycles);
+	if (dram_cycles > 0)
+		r = std::min(r, cfg::CLOCK_FREQUENCY / dram_cycles);
+	return r;
+}
+
+/* Bounds hold for every path not reported yet, so until the first
+ * satisfiable path the last bound is the guarantee, and from then on the
+ * cost of that path. */
+void cfg::stream(const char* type, const std::string& fields) {
+	auto& t = this->trajectory;
+	std::string rate = {};
+	if (this->combined.rate)
+		rate = ",\"rate\":\"" + std::string(this->combined.rate) + "\"";
+	if (!this->index)
+		t.guaranteed[rate] = fields;
+	if (!t.file.is_open() && !t.progress)
+		return;
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - this->start_time;
+	std::ostringstream line;
+	line << "{\"time\":" << json_number(elapsed.count()) << ",\"index\":" << this->index << ",\"type\":\"" << type << "\"" << rate << fields << "}";
+	stream(line.str());
+}
+
+void cfg::stream(const std::string& line) {
+	auto& t = this->trajectory;
+	if (t.file.is_open())
+		t.file << line << "\n" << std::flush;
+	if (t.progress)
+		t.progress(line);
+}
+
+void cfg::stream_bounds(const std::string& file) {
+	this->trajectory.file.open(file, std::ios::out | std::ios::trunc);
+	if (this->trajectory.file.fail())
+		err(-1, "opening %s", file.c_str());
+}
+
+// passes the lines otherwise streamed to a file, without their newline
+void cfg::stream_bounds(std::function<void(const std::string&)> progress) {
+	this->trajectory.progress = progress;
+}
+
+void cfg::set_deadline(std::chrono::time_point<std::chrono::steady_clock> deadline, bool stop) {
+	this->deadline = deadline;
+	this->stop_at_deadline = stop;
+}
+
+// without a timer, enumerations stop on their own after a batch ending past the deadline
+bool cfg::past_deadline() const {
+	return this->cancelled || (this->stop_at_deadline && std::chrono::steady_clock::now() >= this->deadline);
+}
+
+void cfg::cancel() {
+	this->cancelled = true;
+}
+
+// whether the last enumeration ran to its end instead of timing out or being cancelled
+bool cfg::finished() const {
+	return !this->stopped;
+}
+
+// the guarantee of the last configuration as a JSON array, one object per rate
+std::string cfg::final_bound() const {
+	std::string b;
+	for (auto& [rate, fields]: this->trajectory.guaranteed)
+		b += (b.empty() ? "[{" : ",{") + (rate + fields).substr(1) + "}";
+	return b.empty() ? "[]" : b + "]";
+}
+
+/* Larger batches keep the threads busy, but bounds only improve once a
+ * batch is checked. Batches stop growing and shrink again once one takes
+ * more than a quarter of the time left, so the last ones still finish
+ * before the deadline. */
+std::size_t cfg::next_batch(std::size_t k, std::chrono::steady_clock::duration took, bool available) {
+	if (took * 4 > this->deadline - std::chrono::steady_clock::now())
+		return std::max(k*2/3, std::max(PARALLELISM, 1LU));
+	if (k < 20 * PARALLELISM && available)
+		return k + k/2;
+	return k;
+}
+
 template<typename... S>
 void cfg::report_max(const vmax<S...>& max) {
+	if (this->checkpoint.replaying)
+		return;
 	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - this->start_time;
 	auto max_cycles = max.template get<path::MAX_CYCLES>();
 	auto dram_cycles = max.template get<path::DRAM_CYCLES>();
 
 	this->out << "####" << "\n";
 	this->out << this->index << ": " << elapsed.count() << " s\n";
+	if (this->combined.rate)
+		this->out << "rate: " << this->combined.rate << "\n";
 	this->out << "max cycles: " << max_cycles << "\n";
 	this->out << "DRAM cycles: " << dram_cycles << "\n";
 	stats::write(this->out);
 	this->out << "\n" << std::flush;
+
+	std::ostringstream f;
+	f << ",\"max_cycles\":" << json_number(max_cycles);
+	f << ",\"dram_cycles\":" << json_number(dram_cycles);
+	f << ",\"packets/s\":" << json_number(packetrate(max_cycles, dram_cycles));
+	stream("bound", f.str());
 }
 
 template<typename... S>
 void cfg::report_max(const rmax<S...>& max) {
+	if (this->checkpoint.replaying)
+		return;
 	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - this->start_time;
 	auto max_cycles = max.template get<path::MAX_CYCLES>();
 	auto dram_cycles = max.template get<path::DRAM_CYCLES>();
 
 	this->out << "####" << "\n";
 	this->out << this->index << ": " << elapsed.count() << " s\n";
+	if (this->combined.rate)
+		this->out << "rate: " << this->combined.rate << "\n";
 	this->out << "max cycles: " << max_cycles.value << "\n";
 	this->out << "max cycles/b: " << (double) max_cycles << "\n";
 	this->out << "min packet size(max cycles): " << max_cycles.size << "\n";
@@ -2018,6 +2524,12 @@ void cfg::report_max(const rmax<S...>& max) {
 	this->out << "min packet size(DRAM cycles): " << dram_cycles.size << "\n";
 	stats::write(this->out);
 	this->out << "\n" << std::flush;
+
+	std::ostringstream f;
+	f << ",\"max_cycles/b\":" << json_number((double) max_cycles);
+	f << ",\"dram_cycles/b\":" << json_number((double) dram_cycles);
+	f << ",\"bits/s\":" << json_number(8 * packetrate((double) max_cycles, (double) dram_cycles));
+	stream("bound", f.str());
 }
 
 void cfg::report_timeout() {
@@ -2026,6 +2538,309 @@ void cfg::report_timeout() {
 	this->out << this->index << ": " << elapsed.count() << " s\n";
 	stats::write(this->out);
 	this->out << "\n" << std::flush;
+	this->stopped = true;
+	for (auto& [rate, fields]: this->trajectory.guaranteed) {
+		std::ostringstream line;
+		line << "{\"time\":" << json_number(elapsed.count()) << ",\"index\":" << this->index << ",\"type\":\"timeout\"" << rate << fields << "}";
+		stream(line.str());
+	}
+	if (this->curve.enabled)
+		report_curve();
+}
+
+template<typename S>
+void cfg::curve_suffixes(const mpathq::sizev& sizes) {
+	for (auto& b: suffix_bounds<S>(sizes)) {
+		auto i = this->curve.suffixes.emplace(b.size, std::make_tuple(path::MAX_CYCLES::MIN, path::DRAM_CYCLES::MIN)).first;
+		std::get<typename S::value_type>(i->second) = b.value;
+	}
+}
+
+template<typename... S>
+void cfg::curve_path(const pptr& p) {
+	if (p->is_none() || p->is_unsat())
+		return;
+	auto i = this->curve.reported.emplace(p->min_packetsize(), std::make_tuple(path::MAX_CYCLES::MIN, path::DRAM_CYCLES::MIN)).first;
+	((std::get<typename S::value_type>(i->second) = std::max(std::get<typename S::value_type>(i->second), S{}(p))),...);
+}
+
+/* A path is only taken by packets of at least its size class. Below the
+ * bound of the enumeration, paths of a class s are bounded by bound*s as
+ * well as by the longest suffix of the class, so the cycles for a packet
+ * size are bounded by the paths reported up to it and by those classes. */
+void cfg::report_curve() {
+	auto& c = this->curve;
+	auto r = c.reported.begin();
+	auto b = c.suffixes.begin();
+	double cycles = 0;
+	double dram_cycles = 0;
+
+	this->out << "#### Curve" << "\n";
+	this->out << "# size max_cycles dram_cycles packets/s bits/s" << "\n";
+	for (std::uint32_t size = MIN_PACKETSIZE; size <= MTU; size++) {
+		for (; r != c.reported.end() && r->first <= size; r++) {
+			cycles = std::max(cycles, (double) std::get<unsigned int>(r->second));
+			dram_cycles = std::max(dram_cycles, std::get<double>(r->second));
+		}
+		for (; b != c.suffixes.end() && b->first <= size; b++) {
+			cycles = std::max(cycles, std::min((double) std::get<unsigned int>(b->second), std::ceil(c.bound * b->first)));
+			dram_cycles = std::max(dram_cycles, std::min(std::get<double>(b->second), c.bound * b->first / NUM_WORKERS));
+		}
+		double r = packetrate(cycles, dram_cycles);
+		this->out << size << " " << cycles << " " << dram_cycles << " " << r << " " << r * size * 8 << "\n";
+	}
+	this->out << "\n" << std::flush;
+}
+
+/* Paths are reported with decreasing bounds, those above the bound of the
+ * checkpoint and those with the same bound reported before were already
+ * written by the run resumed from. */
+bool cfg::replayed(double bound, const pptr& p) {
+	auto& c = this->checkpoint;
+	if (!c.replaying)
+		return false;
+	if (bound > c.resumed_bound)
+		return true;
+	if (bound == c.resumed_bound) {
+		auto i = c.resumed_ties.find(p->str());
+		if (i != c.resumed_ties.end()) {
+			c.resumed_ties.erase(i);
+			return true;
+		}
+	}
+	c.replaying = false;
+	return false;
+}
+
+/* The queues are not saved, they are rebuilt on resume. The edges which
+ * turned out to need sat checks are saved instead, so rebuilding them
+ * avoids extending most of the impossible paths again, and the checked
+ * paths, so those rebuilt are not checked again. */
+void cfg::save_checkpoint(double bound, const pptr& p) {
+	auto& c = this->checkpoint;
+	if (c.file.empty())
+		return;
+	if (bound != c.bound || c.ties.empty()) {
+		c.bound = bound;
+		c.ties.clear();
+	}
+	c.ties.push_back(p->str());
+
+	if (std::chrono::steady_clock::now() - c.written < std::chrono::seconds(CHECKPOINT_INTERVAL))
+		return;
+	write_checkpoint(false);
+}
+
+/* Also called from the signal handlers, which may interrupt a check holding
+ * the lock, then the last checkpoint is kept. */
+void cfg::write_checkpoint(bool interrupted) {
+	auto& c = this->checkpoint;
+	if (c.file.empty())
+		return;
+	std::unique_lock lock(c.mutex, std::defer_lock);
+	if (!interrupted)
+		lock.lock();
+	else if (!lock.try_lock())
+		return;
+	auto now = std::chrono::steady_clock::now();
+	c.written = now;
+
+	std::string tmp = c.file + ".tmp";
+	std::ofstream f(tmp, std::ios::out | std::ios::trunc);
+	if (f.fail())
+		err(-1, "opening %s", tmp.c_str());
+	std::chrono::duration<double> elapsed = now - this->start_time;
+	f << "fingerprint " << c.fingerprint << "\n";
+	f << "index " << this->index << "\n";
+	f << "elapsed " << std::hexfloat << elapsed.count() << "\n";
+	// without a reported path, there is nothing to replay
+	if (!c.ties.empty())
+		f << "bound " << c.bound << "\n";
+	f << std::defaultfloat;
+	for (auto& t: c.ties)
+		f << "tie " << t << "\n";
+	for (auto& s: c.settled)
+		f << s << "\n";
+	for (nptr nd: this->nodes) {
+		for (auto [s, branchtrue]: nd->succ()) {
+			if (s.get().sat_check)
+				f << "satcheck " << nd->did() << " " << branchtrue << "\n";
+		}
+	}
+	f.close();
+	if (f.fail())
+		errx(-1, "error writing %s", tmp.c_str());
+	if (std::rename(tmp.c_str(), c.file.c_str()))
+		err(-1, "rename(%s)", c.file.c_str());
+}
+
+void cfg::resume(const std::string& file, const std::string& fingerprint) {
+	auto& c = this->checkpoint;
+	c.file = file;
+	c.fingerprint = fingerprint;
+
+	std::ifstream f(file, std::ios::in);
+	if (f.fail())
+		return;
+
+	std::map<std::string,nptr> nodes;
+	for (nptr nd: this->nodes)
+		nodes[nd->did()] = nd;
+
+	std::string line;
+	while (std::getline(f, line)) {
+		std::istringstream l(line);
+		std::string key, value;
+		l >> key >> value;
+		if (key == "fingerprint") {
+			if (value != fingerprint)
+				errx(-1, "checkpoint %s is from a different analysis", file.c_str());
+		} else if (key == "index") {
+			this->index = std::strtoul(value.c_str(), nullptr, 10);
+		} else if (key == "elapsed") {
+			this->start_time -= std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(std::strtod(value.c_str(), nullptr)));
+		} else if (key == "bound") {
+			c.resumed_bound = std::strtod(value.c_str(), nullptr);
+			c.replaying = true;
+		} else if (key == "tie") {
+			c.resumed_ties.insert(value);
+		} else if (key == "unsat") {
+			c.resumed_unsat.insert(value);
+			c.settled.push_back(line);
+		} else if (key == "sat") {
+			std::string id;
+			l >> id;
+			c.resumed_sat[id] = std::strtoul(value.c_str(), nullptr, 10);
+			c.settled.push_back(line);
+		} else if (key == "satcheck") {
+			bool branchtrue = false;
+			l >> branchtrue;
+			auto i = nodes.find(value);
+			if (i != nodes.end())
+				i->second->enable_sat_check(branchtrue);
+		} else {
+			errx(-1, "invalid checkpoint %s: %s", file.c_str(), line.c_str());
+		}
+	}
+}
+
+static std::string sha256(const std::string& s) {
+	unsigned char hash[SHA256_DIGEST_LENGTH];
+	SHA256(reinterpret_cast<const unsigned char*>(s.data()), s.size(), hash);
+	std::ostringstream h;
+	for (int i = 0; i < SHA256_DIGEST_LENGTH; i++)
+		h << std::hex << std::setw(2) << std::setfill('0') << (int) hash[i];
+	return h.str();
+}
+
+/* A node's state only depends on the nodes before it, so its hash covers
+ * its instructions, its outdegree and the hashes of its predecessors in
+ * the order their states are merged. Addresses are left out, so code
+ * moved by a change elsewhere keeps its hash. */
+void cfg::hash_nodes() {
+	topo_sort();
+	std::map<nptr,std::size_t> order;
+	for (std::size_t i = 0; i < this->nodes.size(); i++)
+		order[this->nodes[i]] = i;
+
+	std::ostringstream settings;
+	settings << features::values() << " " << MIN_PACKETSIZE << " " << MTU << " " << PACKET_HEADROOM;
+	auto& hashes = this->cache.hashes;
+	hashes.clear();
+	for (nptr nd: this->nodes) {
+		std::ostringstream c;
+		if (nd == this->start.nd)
+			c << settings.str() << "\n";
+		for (auto& i: nd->instrs())
+			c << i->content() << "\n";
+		c << nd->loopdepth() << " " << nd->outdegree() << "\n";
+		std::vector<std::pair<std::size_t,bool>> preds;
+		for (auto& pr: nd->pred())
+			preds.push_back(std::make_pair(order.at(pr.nd), !pr.branchtrue));
+		std::sort(preds.begin(), preds.end());
+		for (auto [i, branchfalse]: preds)
+			c << hashes.at(this->nodes[i]) << " " << !branchfalse << "\n";
+		hashes[nd] = sha256(c.str());
+	}
+}
+
+void cfg::use_cache(const std::string& file) {
+	this->cache.file = file;
+	hash_nodes();
+
+	std::ifstream f(file, std::ios::in);
+	if (f.fail())
+		return;
+
+	std::map<std::string,nptr> nodes;
+	for (auto [nd, h]: this->cache.hashes)
+		nodes[h] = nd;
+
+	static stats::counter s_cached_sat_checks("cache.sat-checks");
+	std::string line;
+	while (std::getline(f, line)) {
+		std::istringstream l(line);
+		std::string key, hash;
+		bool branchtrue = false;
+		l >> key >> hash >> branchtrue;
+		if (key == "minimized") {
+			std::string sat;
+			std::uint32_t min_value = 0;
+			l >> sat >> min_value;
+			std::optional<bool> r;
+			if (sat != "-")
+				r = sat == "sat";
+			this->cache.minimized[std::make_pair(hash, branchtrue)] = std::make_pair(r, min_value);
+		} else if (key == "satcheck") {
+			this->cache.sat_checks.insert(std::make_pair(hash, branchtrue));
+			auto i = nodes.find(hash);
+			if (i == nodes.end())
+				continue;
+			i->second->enable_sat_check(branchtrue);
+			s_cached_sat_checks.count();
+		} else {
+			errx(-1, "invalid cache %s: %s", file.c_str(), line.c_str());
+		}
+	}
+}
+
+// entries of other versions of the program are kept as well
+void cfg::save_cache() {
+	auto& c = this->cache;
+	if (c.file.empty())
+		return;
+
+	for (nptr nd: this->nodes) {
+		auto h = c.hashes.find(nd);
+		if (h == c.hashes.end())
+			continue;
+		for (auto [s, branchtrue]: nd->succ()) {
+			if (s.get().sat_check)
+				c.sat_checks.insert(std::make_pair(h->second, branchtrue));
+		}
+	}
+
+	// processes of a batch or server may share the cache
+	std::string tmp = c.file + "." + std::to_string(getpid()) + ".tmp";
+	std::ofstream f(tmp, std::ios::out | std::ios::trunc);
+	if (f.fail())
+		err(-1, "opening %s", tmp.c_str());
+	for (auto& [e, r]: c.minimized) {
+		f << "minimized " << e.first << " " << e.second << " ";
+		if (!r.first) {
+			f << "-";
+		} else {
+			f << (*r.first ? "sat" : "unsat");
+		}
+		f << " " << r.second << "\n";
+	}
+	for (auto& e: c.sat_checks)
+		f << "satcheck " << e.first << " " << e.second << "\n";
+	f.close();
+	if (f.fail())
+		errx(-1, "error writing %s", tmp.c_str());
+	if (std::rename(tmp.c_str(), c.file.c_str()))
+		err(-1, "rename(%s)", c.file.c_str());
 }
 
 void cfg::report_path(pptr p) {
@@ -2033,6 +2848,8 @@ void cfg::report_path(pptr p) {
 	std::shared_ptr<const path::possible> pp = std::dynamic_pointer_cast<const path::possible>(p);
 	this->out << "#### " << p->str() << "\n";
 	this->out << this->index << ": " << elapsed.count() << " s\n";
+	if (this->combined.rate)
+		this->out << "rate: " << this->combined.rate << "\n";
 	this->out << "max cycles: " << p->max_cycles() << "\n";
 	this->out << "max cycles/b: " << (double) path::cycleratio(p->max_cycles(), p->min_packetsize()) << "\n";
 	this->out << "DRAM cycles: " << p->dram_cycles() << "\n";
@@ -2083,12 +2900,92 @@ void cfg::report_path(pptr p) {
 
 	stats::write(this->out);
 	this->out << "\n" << std::flush;
+
+	std::ostringstream f;
+	f << ",\"path\":\"" << p->str() << "\"";
+	f << ",\"max_cycles\":" << json_number(p->max_cycles());
+	f << ",\"dram_cycles\":" << json_number(p->dram_cycles());
+	f << ",\"min_packetsize\":" << p->min_packetsize();
+	stream("path", f.str());
 	this->index += 1;
 }
 
+/* While sweeping, feasibility does not depend on the workers or the
+ * firmware cost, and the MTU only decreases, so a path found unsat for one
+ * configuration is unsat for all later ones. */
+cfg::pptr cfg::check(const pptr& p) {
+	auto pp = std::dynamic_pointer_cast<path::possible>(p);
+	// both rates of the combined mode may check the same path at once
+	std::unique_lock<std::mutex> lock;
+	if (this->combined.enabled && pp)
+		lock = std::unique_lock(this->combined.checking[std::hash<path*>{}(p.get()) % std::size(this->combined.checking)]);
+	if (!this->checkpoint.file.empty() && !p->is_decided())
+		return check_settled(p);
+	if (!this->sweep.enabled || !pp || p->is_decided())
+		return p->check();
+
+	static stats::counter s_swept_unsat("cfg.sweep.unsat");
+	std::string id = p->str();
+	{
+		std::lock_guard guard(this->sweep.mutex);
+		if (this->sweep.unsat.find(id) != this->sweep.unsat.end()) {
+			s_swept_unsat.count();
+			return pp->to_impossible();
+		}
+	}
+	pptr c = p->check();
+	if (c->is_unsat()) {
+		std::lock_guard guard(this->sweep.mutex);
+		this->sweep.unsat.insert(id);
+	}
+	return c;
+}
+
+/* With a checkpoint, the outcome of every check is saved with it, and the
+ * paths checked by the run resumed from are settled without z3. */
+cfg::pptr cfg::check_settled(const pptr& p) {
+	static stats::counter s_settled("cfg.checkpoint.settled");
+	auto& c = this->checkpoint;
+	std::string id = p->str();
+	if (auto pp = std::dynamic_pointer_cast<path::possible>(p)) {
+		if (c.resumed_unsat.count(id)) {
+			s_settled.count();
+			return pp->to_impossible();
+		}
+		auto i = c.resumed_sat.find(id);
+		if (i != c.resumed_sat.end()) {
+			s_settled.count();
+			return pp->settle(i->second);
+		}
+	}
+	pptr r = p->check();
+	std::lock_guard guard(c.mutex);
+	if (r->is_unsat())
+		c.settled.push_back("unsat " + id);
+	else if (r->is_decided())
+		c.settled.push_back("sat " + std::to_string(r->min_packetsize()) + " " + id);
+	return r;
+}
+
+void cfg::configure(unsigned int workers, unsigned int cost, std::uint32_t mtu) {
+	if (this->sweep.enabled && mtu > MTU)
+		this->sweep.unsat.clear();
+	this->sweep.enabled = true;
+	NUM_WORKERS = workers;
+	COST_FIRMWARE = cost;
+	MTU = mtu;
+	share_settings();
+	this->index = 0;
+	this->stopped = false;
+	this->start_time = std::chrono::steady_clock::now();
+	this->checkpoint.replaying = false;
+	this->trajectory.guaranteed.clear();
+}
+
 template<typename... S>
 void cfg::enumerate_by_packetrate(std::size_t count) {
 	overestimate_cycles();
+	longest_suffixes<S...>();
 	auto max = vmax<S...>(underestimate_packetrate<S>()...);
 	ipathq iq(max);
 	report_max(max);
@@ -2099,35 +2996,59 @@ void cfg::enumerate_by_packetrate(std::size_t count) {
 	pptr none = std::make_shared<path::none>();
 	(this->start.nd->qpush<S>(true, {start, none}),...);
 	(this->start.nd->qpush<S>(false, {start, none}),...);
+	std::tuple<kpaths<S>...> engines = {kpaths<S>(*this, start)...};
 	std::size_t k = std::max(PARALLELISM, 1LU);
 
-	for (bool done = false; !done;) {
-		auto ordered = thread_pool.ordered_completion<pptr>();
-		iq.pull(k, [this](std::size_t k) { return next_k<S>(k); }...);
+	// extending the next batch overlaps with checking the previous one, only reports are ordered
+	std::atomic<bool> done = false;
+	bool timed_out = false;
+	auto ordered = thread_pool.ordered_completion<pptr>();
+	for (unsigned long previous = 0; !done;) {
+		auto begun = std::chrono::steady_clock::now();
+		if (o_k_longest_paths) {
+			iq.pull(k, [&engines](std::size_t k) { return std::get<kpaths<S>>(engines).next(k); }...);
+		} else {
+			iq.pull(k, [this](std::size_t k) { return next_k<S>(k); }...);
+		}
 		pptr f = iq.front();
-		vmax m = vmax<S...>(f);
-		if (f && !f->is_decided() && m < max)
-			report_max(m);
+		ordered.sync([&,f](unsigned long i) {
+			vmax m = vmax<S...>(f);
+			if (!done && f && !f->is_decided() && m < max)
+				report_max(m);
+		});
 		while (pptr p = iq.take()) {
 			pptr n = iq.front();
-			ordered.delegate([p] {
-				return p->check();
-			}, [&,n](pptr p, unsigned int i) {
-				report_path(p);
+			ordered.delegate([this,p] {
+				return check(p);
+			}, [&,n](pptr p, unsigned long i) {
+				if (done)
+					return;
+				max = vmax<S...>(p);
+				if (!replayed(max.max(), p)) {
+					report_path(p);
+					save_checkpoint(max.max(), p);
+				}
 				if (this->index >= count || p->is_none())
 					done = true;
-				max = vmax<S...>(p);
 				vmax m = vmax<S...>(n);
 				if (n && !n->is_decided() && m < max && !ordered.waiting(i+1))
 					report_max(m);
-			});
+			}, thread_pool::HIGH);
 		}
-		this->thread_pool.wait();
-		if (o_keep_impossible_paths)
+		ordered.wait(previous);
+		previous = ordered.mark();
+		if (o_keep_impossible_paths && !o_k_longest_paths)
 			(push_impossible<S>(),...);
-		if (k < 20 * PARALLELISM && mem_available())
-			k = k + k/2;
+		bool available = mem_available();
+		k = next_batch(k, std::chrono::steady_clock::now() - begun, available);
+		this->spilling = o_spill_paths && !available;
+		if (past_deadline())
+			done = timed_out = true;
 	}
+	ordered.wait();
+	if (timed_out)
+		report_timeout();
+	save_cache();
 
 	for (nptr nd: this->nodes)
 		nd->reset<S...>();
@@ -2137,9 +3058,17 @@ template<typename... S>
 void cfg::enumerate_by_bitrate(std::size_t count) {
 	overestimate_cycles();
 	mpathq::sizev sizes = propagate_sizes<S...>();
+	longest_suffixes<S...>();
 	auto max = rmax<S...>(underestimate_bitrate<S>(sizes)...);
 	report_max(max);
 	itpathq itq(sizes, max);
+	(itq.template bound<S>(suffix_bounds<S>(sizes)),...);
+	if (this->curve.enabled) {
+		this->curve.reported.clear();
+		this->curve.suffixes.clear();
+		(curve_suffixes<S>(sizes),...);
+		this->curve.bound = max.max();
+	}
 	if (!count)
 		return;
 
@@ -2149,40 +3078,201 @@ void cfg::enumerate_by_bitrate(std::size_t count) {
 	(this->start.nd->mqpush<S>(false, {start, none}),...);
 	std::size_t k = std::max(PARALLELISM, 1LU);
 
-	for (bool done = false; !done;) {
-		auto w = [&] {
-			while (pptr l = itq.take_lowest_bitrate()) {
-				l = l->check();
+	std::atomic<bool> done = false;
+	bool timed_out = false;
+	auto ordered = thread_pool.ordered_completion<pptr>();
+	auto guard = [&ordered](const std::function<void()>& f) {
+		ordered.lock(f);
+	};
+	// runs in order with the completions, holding the lock of the ordered completion
+	auto w = [&] {
+		if (done)
+			return;
+		while (pptr l = itq.take_lowest_bitrate()) {
+			l = check(l);
+			max = rmax<S...>(l);
+			if (!replayed(max.max(), l)) {
 				report_path(l);
-				if (this->index >= count || l->is_none())
-					done = true;
-				max = rmax<S...>(l);
+				save_checkpoint(max.max(), l);
 			}
-			auto f = itq.front();
-			auto m = rmax<S...>(f->first, f->second);
-			if (f && !f->first->is_decided() && m < max) {
-				report_max(m);
-				max = m;
-			}
-		};
+			if (this->curve.enabled)
+				curve_path<S...>(l);
+			if (this->index >= count || l->is_none())
+				done = true;
+		}
+		auto f = itq.front();
+		auto m = rmax<S...>(f->first, f->second);
+		if (f && !f->first->is_decided() && m < max) {
+			report_max(m);
+			max = m;
+		}
+		this->curve.bound = std::max(0.0, max.max());
+	};
 
-		auto ordered = thread_pool.ordered_completion<pptr>();
-		itq.pull(k, [this,&itq](std::size_t k) { return next_k<S>(itq.template sizes_to<S>(k)); }...);
-		w();
-		while (pptr p = itq.take_undecided()) {
-			ordered.delegate([p] {
-				return p->check();
-			}, [&,p](pptr c, unsigned int i) {
+	for (unsigned long previous = 0; !done;) {
+		auto begun = std::chrono::steady_clock::now();
+		itq.pull(k, guard, [this](const mpathq::sizev& k) { return next_k<S>(k); }...);
+		ordered.sync([&](unsigned long i) {
+			w();
+		});
+		while (pptr p = ordered.lock([&] { return itq.take_undecided(); })) {
+			ordered.delegate([this,p] {
+				return check(p);
+			}, [&,p](pptr c, unsigned long i) {
 				itq.adjust_size(p, c);
 				w();
-			});
+			}, thread_pool::HIGH);
 		}
-		this->thread_pool.wait();
+		ordered.wait(previous);
+		previous = ordered.mark();
 		if (o_keep_impossible_paths)
 			(push_mimpossible<S>(),...);
-		if (k < 20 * PARALLELISM && mem_available())
-			k = k + k/2;
-	}
+		bool available = mem_available();
+		k = next_batch(k, std::chrono::steady_clock::now() - begun, available);
+		this->spilling = o_spill_paths && !available;
+		if (past_deadline())
+			done = timed_out = true;
+	}
+	ordered.wait();
+	if (timed_out)
+		report_timeout();
+	save_cache();
+	if (this->curve.enabled)
+		report_curve();
+
+	for (nptr nd: this->nodes)
+		nd->reset<S...>();
+}
+
+/* Enumerates by packet rate and by bit rate at once. Both start from the
+ * same path, and as extensions are kept by the path extended and checks
+ * decide the state of the path checked, each rate reuses the paths the
+ * other one extended or checked while they are still queued. The rates
+ * are reported with their own index and stop independently. */
+template<typename... S>
+void cfg::enumerate_by_rates(std::size_t count) {
+	overestimate_cycles();
+	mpathq::sizev sizes = propagate_sizes<S...>();
+	longest_suffixes<S...>();
+	auto pmax = vmax<S...>(underestimate_packetrate<S>()...);
+	auto bmax = rmax<S...>(underestimate_bitrate<S>(sizes)...);
+	ipathq iq(pmax);
+	itpathq itq(sizes, bmax);
+	(itq.template bound<S>(suffix_bounds<S>(sizes)),...);
+
+	unsigned long index[2] = {this->index, this->index};
+	// runs f as one of the rates, callers hold the lock of the ordered completion
+	auto as = [&](std::size_t r, const auto& f) {
+		std::swap(this->index, index[r]);
+		this->combined.rate = r ? "bit" : "packet";
+		f();
+		this->combined.rate = nullptr;
+		std::swap(this->index, index[r]);
+	};
+	as(0, [&] { report_max(pmax); });
+	as(1, [&] { report_max(bmax); });
+	if (!count)
+		return;
+	this->combined.enabled = true;
+
+	pptr start = std::make_shared<path::possible>(nullptr, this->start, MIN_PACKETSIZE, initial_state(), true);
+	pptr none = std::make_shared<path::none>();
+	(this->start.nd->qpush<S>(true, {start, none}),...);
+	(this->start.nd->qpush<S>(false, {start, none}),...);
+	(this->start.nd->mqpush<S>(true, {start, none}),...);
+	(this->start.nd->mqpush<S>(false, {start, none}),...);
+	std::tuple<kpaths<S>...> engines = {kpaths<S>(*this, start)...};
+	std::size_t k = std::max(PARALLELISM, 1LU);
+
+	std::atomic<bool> pdone = false;
+	std::atomic<bool> bdone = false;
+	bool timed_out = false;
+	auto ordered = thread_pool.ordered_completion<pptr>();
+	auto guard = [&ordered](const std::function<void()>& f) {
+		ordered.lock(f);
+	};
+	auto w = [&] {
+		if (bdone)
+			return;
+		while (pptr l = itq.take_lowest_bitrate()) {
+			l = check(l);
+			bmax = rmax<S...>(l);
+			as(1, [&] { report_path(l); });
+			if (index[1] >= count || l->is_none())
+				bdone = true;
+		}
+		auto f = itq.front();
+		auto m = rmax<S...>(f->first, f->second);
+		if (f && !f->first->is_decided() && m < bmax) {
+			as(1, [&] { report_max(m); });
+			bmax = m;
+		}
+	};
+
+	for (unsigned long previous = 0; !pdone || !bdone;) {
+		auto begun = std::chrono::steady_clock::now();
+		if (!pdone) {
+			if (o_k_longest_paths) {
+				iq.pull(k, [&engines](std::size_t k) { return std::get<kpaths<S>>(engines).next(k); }...);
+			} else {
+				iq.pull(k, [this](std::size_t k) { return next_k<S>(k); }...);
+			}
+			pptr f = iq.front();
+			ordered.sync([&,f](unsigned long i) {
+				vmax m = vmax<S...>(f);
+				if (!pdone && f && !f->is_decided() && m < pmax)
+					as(0, [&] { report_max(m); });
+			});
+			while (pptr p = iq.take()) {
+				pptr n = iq.front();
+				ordered.delegate([this,p] {
+					return check(p);
+				}, [&,n](pptr p, unsigned long i) {
+					if (pdone)
+						return;
+					pmax = vmax<S...>(p);
+					as(0, [&] { report_path(p); });
+					if (index[0] >= count || p->is_none())
+						pdone = true;
+					vmax m = vmax<S...>(n);
+					if (n && !n->is_decided() && m < pmax && !ordered.waiting(i+1))
+						as(0, [&] { report_max(m); });
+				}, thread_pool::HIGH);
+			}
+		}
+		if (!bdone) {
+			itq.pull(k, guard, [this](const mpathq::sizev& k) { return next_k<S>(k); }...);
+			ordered.sync([&](unsigned long i) {
+				w();
+			});
+			while (pptr p = ordered.lock([&] { return itq.take_undecided(); })) {
+				ordered.delegate([this,p] {
+					return check(p);
+				}, [&,p](pptr c, unsigned long i) {
+					itq.adjust_size(p, c);
+					w();
+				}, thread_pool::HIGH);
+			}
+		}
+		ordered.wait(previous);
+		previous = ordered.mark();
+		if (o_keep_impossible_paths) {
+			if (!o_k_longest_paths)
+				(push_impossible<S>(),...);
+			(push_mimpossible<S>(),...);
+		}
+		bool available = mem_available();
+		k = next_batch(k, std::chrono::steady_clock::now() - begun, available);
+		this->spilling = o_spill_paths && !available;
+		if (past_deadline())
+			pdone = bdone = timed_out = true;
+	}
+	ordered.wait();
+	if (timed_out)
+		report_timeout();
+	this->combined.enabled = false;
+	this->index = std::max(index[0], index[1]);
+	save_cache();
 
 	for (nptr nd: this->nodes)
 		nd->reset<S...>();
@@ -2212,6 +3302,15 @@ void cfg::enumerate_by_bitrate(std::size_t count){
 	enumerate_by_bitrate<path::MAX_CYCLES,path::DRAM_CYCLES>(count);
 }
 
+void cfg::enumerate_by_rates(std::size_t count) {
+	enumerate_by_rates<path::MAX_CYCLES,path::DRAM_CYCLES>(count);
+}
+
+void cfg::enumerate_curve(std::size_t count) {
+	this->curve.enabled = true;
+	enumerate_by_bitrate<path::MAX_CYCLES,path::DRAM_CYCLES>(count);
+}
+
 void cfg::save_dot_graph() const {
 	this->out << "digraph asm{\n";
 	for(nptr nd: this->nodes){
@@ -2226,56 +3325,203 @@ void cfg::save_dot_graph() const {
 	this->out << "}\n";
 }
 
+/* nodes are scheduled as a dataflow graph, a node runs once every incoming
+ * edge delivered its state or was found unsatisfiable, incoming states are
+ * merged in topological order of their predecessors as before */
 void cfg::static_analysis(bool sat_check) {
 	topo_sort();
+	// the settings are part of the hashes and may have changed since
+	if (!this->cache.file.empty())
+		hash_nodes();
+
+	struct flow {
+		std::mutex mutex;
+		std::size_t remaining;
+		std::map<std::pair<std::size_t,bool>,state::exec> incoming = {};
+		bool reached = false;
+	};
+	std::map<nptr,std::size_t> order;
+	for (std::size_t i = 0; i < this->nodes.size(); i++)
+		order[this->nodes[i]] = i;
+	std::vector<flow> flows(this->nodes.size());
+	for (std::size_t i = 0; i < this->nodes.size(); i++)
+		flows[i].remaining = this->nodes[i]->indegree();
+
+	std::mutex mutex;
+	std::vector<std::pair<nptr,bool>> unsat_edges;
+	std::vector<nptr> dead;
+	thread_pool::group group(this->thread_pool);
+	std::function<void(std::size_t)> process;
+
+	/* nodes become ready deep inside the tasks of their predecessors, a
+	 * single drainer delegates them, so that a pool without threads runs
+	 * them one after another instead of recursing along the cfg */
+	std::mutex worklist_mutex;
+	std::deque<std::size_t> worklist;
+	bool draining = false;
+	auto schedule = [&](std::size_t i) {
+		{
+			std::lock_guard guard(worklist_mutex);
+			worklist.push_back(i);
+			if (draining)
+				return;
+			draining = true;
+		}
+		for (;;) {
+			std::size_t n;
+			{
+				std::lock_guard guard(worklist_mutex);
+				if (worklist.empty()) {
+					draining = false;
+					return;
+				}
+				n = worklist.front();
+				worklist.pop_front();
+			}
+			group.delegate([&process,n] { process(n); });
+		}
+	};
 
-	std::map<nptr,state::exec> map;
-	map[this->start.nd] = initial_state();
+	static stats::counter s_cached_minimized("cache.minimized");
+	auto minimize = [this](nptr nd, bool branchtrue, state::exec& sstate) {
+		auto h = this->cache.hashes.find(nd);
+		if (h == this->cache.hashes.end()) {
+			sstate.partial_minimize();
+			return;
+		}
+		auto e = std::make_pair(h->second, branchtrue);
+		{
+			std::lock_guard guard(this->cache.mutex);
+			auto c = this->cache.minimized.find(e);
+			if (c != this->cache.minimized.end()) {
+				sstate.assume_minimized(c->second.first, c->second.second);
+				s_cached_minimized.count();
+				return;
+			}
+		}
+		sstate.partial_minimize();
+		std::lock_guard guard(this->cache.mutex);
+		this->cache.minimized[e] = std::make_pair(sstate.is_sat(), sstate.minimum_value());
+	};
 
-	for (nptr nd: this->nodes) {
-		if (!nd->indegree() && nd != this->start.nd) {
-			nd->unlink();
-			continue;
+	auto arrive = [&](nptr nd, bool branchtrue, nptr s, std::optional<state::exec> sstate) {
+		std::size_t i = order.at(s);
+		flow& f = flows[i];
+		bool ready;
+		{
+			std::lock_guard guard(f.mutex);
+			if (f.reached)
+				return;
+			if (sstate)
+				f.incoming.emplace(std::make_pair(order.at(nd), !branchtrue), std::move(*sstate));
+			ready = f.reached = !--f.remaining;
+		}
+		if (ready)
+			schedule(i);
+	};
+
+	process = [&](std::size_t n) {
+		nptr nd = this->nodes[n];
+		flow& f = flows[n];
+		if (f.incoming.empty() && nd != this->start.nd) {
+			{
+				std::lock_guard guard(mutex);
+				dead.push_back(nd);
+			}
+			for (auto [s, branchtrue]: nd->succ())
+				arrive(nd, branchtrue, s.get().nd, {});
+			return;
+		}
+
+		auto state = std::make_shared<state::exec>();
+		if (nd == this->start.nd) {
+			*state = initial_state();
+		} else {
+			// past a few incoming states the abstract values are widened,
+			// so that wide joins keep coarse but stable bounds
+			const std::size_t widen_after = 4;
+			std::size_t merged = 1;
+			auto i = f.incoming.begin();
+			*state = std::move(i->second);
+			for (i++; i != f.incoming.end(); i++)
+				*state = state->static_merge(i->second, ++merged > widen_after);
 		}
-		state::exec& state = map[nd];
+		// all predecessors have delivered their states
+		f.incoming.clear();
 		for (auto i = nd->instrs().begin(); i != nd->instrs().end()-1; i++)
-			state.apply(**i, state::perf::info(), nd->loopdepth());
-		auto ordered = thread_pool.ordered_completion<state::exec>();
+			state->apply(**i, state::perf::info(), nd->loopdepth());
+		state->freeze();
+
+		std::size_t outdegree = nd->outdegree();
 		for (auto [s, branchtrue]: nd->succ()) {
-			ordered.delegate([&,s,branchtrue] {
-				state::exec sstate = state;
+			group.delegate([&,nd,state,s=s,branchtrue=branchtrue,outdegree] {
+				state::exec sstate = *state;
 				auto& i = nd->instrs().back();
 				sstate.apply(*i, state::perf::info(), nd->loopdepth(), branchtrue);
-				if (sat_check && nd->outdegree() > 1)
-					sstate.partial_minimize();
-				return sstate;
-			}, [&,s,branchtrue](state::exec sstate, unsigned long i) {
+				if (sat_check && outdegree > 1 && !sstate.is_decided())
+					minimize(nd, branchtrue, sstate);
 				if (sstate.is_unsat()) {
-					nd->unlink(branchtrue);
+					{
+						std::lock_guard guard(mutex);
+						unsat_edges.push_back(std::make_pair(nd, branchtrue));
+					}
+					arrive(nd, branchtrue, s.get().nd, {});
 					return;
 				}
 				s.get().min_packetsize = sstate.minimum_value();
-				auto m = map.find(s.get().nd);
-				if (m == map.end()) {
-					map[s.get().nd] = sstate;
-				} else {
-					map[s.get().nd] = m->second.static_merge(sstate);
-				}
+				arrive(nd, branchtrue, s.get().nd, std::move(sstate));
 			});
 		}
-		this->thread_pool.wait();
+	};
+
+	for (std::size_t i = 0; i < this->nodes.size(); i++) {
+		if (!flows[i].remaining) {
+			flows[i].reached = true;
+			schedule(i);
+		}
 	}
+	group.wait();
+	// nodes behind unreachable cycles never become ready, take them in order
+	for (std::size_t i = 0; i < this->nodes.size(); i++) {
+		if (flows[i].reached)
+			continue;
+		flows[i].reached = true;
+		if (flows[i].incoming.empty())
+			continue;
+		process(i);
+		group.wait();
+	}
+
+	// edges and nodes are only unlinked once no task looks at the cfg anymore
+	std::sort(unsat_edges.begin(), unsat_edges.end(), [&order](const auto& a, const auto& b) {
+		return order.at(a.first) < order.at(b.first) || (a.first == b.first && a.second > b.second);
+	});
+	for (auto [nd, branchtrue]: unsat_edges)
+		nd->unlink(branchtrue);
+	std::sort(dead.begin(), dead.end(), [&order](const nptr& a, const nptr& b) {
+		return order.at(a) < order.at(b);
+	});
+	for (nptr nd: dead)
+		nd->unlink();
 	for (auto i = this->nodes.rbegin(); i != this->nodes.rend(); i++) {
 		if (!(*i)->outdegree() && *i != this->fin_nd)
 			(*i)->unlink();
 	}
 
 	remove_unreachable();
+	save_cache();
 }
 
 void cfg::overestimate_cycles() {
 	topo_sort();
 
+	// also rebuilt when enumerating again for another configuration
+	this->start.instructions.clear();
+	for (nptr nd: this->nodes) {
+		for (auto& s: nd->succ())
+			s.first.get().instructions.clear();
+	}
+
 	this->start.instructions.reserve(this->start.nd->instrs().size());
 	for (auto& i: this->start.nd->instrs())
 		this->start.instructions.push_back(i);
@@ -2309,11 +3555,72 @@ void cfg::overestimate_cycles() {
 	}
 }
 
+// increase of S by extending a path on s, independent of the path as instructions are overestimated
+template<typename S>
+typename S::value_type cfg::weight(const succ_data& s, bool branchtrue) {
+	pptr p = std::make_shared<path::impossible>(s, 0, state::perf());
+	return S{}(p, branchtrue) - S{}(p);
+}
+
+/* Exact longest suffixes per edge in reverse topological order, overall
+ * and for each packet size an edge may lead to. They bound every path
+ * reaching an edge regardless of its prefix. */
+template<typename... S>
+void cfg::longest_suffixes() {
+	auto fill = [this](succ_data& e, auto v) {
+		using V = decltype(v);
+		auto& d = e.d<V>();
+		d.suffixes.clear();
+		if (e.nd == this->fin_nd) {
+			d.suffix = typename V::value_type();
+			for (auto [s,ss]: e.sizes)
+				d.suffixes[s] = typename V::value_type();
+			return;
+		}
+		d.suffix = V::MIN;
+		for (auto [n, branchtrue]: e.nd->succ()) {
+			auto& nd = n.get().template d<V>();
+			auto w = weight<V>(e, branchtrue);
+			d.suffix = std::max(d.suffix, w + nd.suffix);
+			for (auto [s,ss]: e.sizes) {
+				auto i = nd.suffixes.find(s);
+				if (i == nd.suffixes.end())
+					continue;
+				auto j = d.suffixes.emplace(s, w + i->second).first;
+				j->second = std::max(j->second, w + i->second);
+			}
+		}
+	};
+
+	for (auto i = this->nodes.rbegin(); i != this->nodes.rend(); i++) {
+		for (auto& pr: (*i)->pred())
+			(fill(pr.nd->succ(pr.branchtrue), S{}),...);
+	}
+	(fill(this->start, S{}),...);
+}
+
+template<typename S>
+std::vector<cfg::tratio<S>> cfg::suffix_bounds(const mpathq::sizev& sizes) {
+	path::iptr start = std::make_shared<path::impossible>(this->start, MIN_PACKETSIZE, initial_state());
+	auto& suffixes = this->start.d<S>().suffixes;
+	std::vector<tratio<S>> bounds;
+	for (auto [s,ss]: sizes) {
+		auto i = suffixes.find(s);
+		if (i != suffixes.end())
+			bounds.push_back(tratio<S>(S{}(start) + i->second, s));
+	}
+	return bounds;
+}
+
 template<typename... S>
 cfg::mpathq::sizev cfg::propagate_sizes() {
 	std::map<succ_data*,mpathq::sizev> possible;
 	std::map<succ_data*,mpathq::sizev> produced;
 
+	for (nptr nd: this->nodes) {
+		for (auto& pr: nd->pred())
+			pr.nd->succ(pr.branchtrue).sizes = {};
+	}
 	for (auto i = this->nodes.rbegin(); i != this->nodes.rend(); i++) {
 		for (auto& pr: (*i)->pred()) {
 			succ_data& ps = pr.nd->succ(pr.branchtrue);
@@ -2387,6 +3694,8 @@ std::set<cfg::nptr> cfg::loopfree_nodes() {
 	return nds;
 }
 
+/* iterations are separate nodes sharing the instructions of their base
+ * node, their path queues only allocate once a path reaches them */
 void cfg::unroll(std::size_t limit, const std::map<std::uint32_t,std::size_t>& limits) {
 	std::set<nptr> nounroll = loopfree_nodes();
 
@@ -2438,15 +3747,183 @@ void cfg::unroll(std::size_t limit, const std::map<std::uint32_t,std::size_t>& l
 	this->nodes.reserve(this->nodes.size() + unrolled.size());
 	for (auto u: unrolled)
 		this->nodes.push_back(u.second);
+	// base nodes and iterations cut off at the limit are not reachable anymore
+	remove_unreachable();
+}
+
+/* Replaces all but the last iteration of bounded loops by an instr::summary on
+ * the entry edges. The summary costs the longest path through one iteration
+ * times the remaining iterations and leaves everything the loop writes
+ * undefined, so only the paths of a single iteration are enumerated. Inner
+ * loops are summarized first; loops with more than one entry are left to
+ * unroll. */
+void cfg::summarize_loops(std::size_t limit, const std::map<std::uint32_t,std::size_t>& limits) {
+	static stats::counter s_summarized_loops("cfg.summarized-loops");
+
+	// the cyclic strongly connected components of nds, ignoring edges into skip
+	auto components = [](const std::vector<nptr>& nds, nptr skip) {
+		std::unordered_set<nptr> within(nds.begin(), nds.end());
+		std::unordered_map<nptr,std::size_t> index;
+		std::unordered_map<nptr,std::size_t> low;
+		std::unordered_set<nptr> onstack;
+		std::stack<nptr> stack;
+		std::vector<std::vector<nptr>> sccs;
+
+		std::function<void(nptr)> visit = [&](nptr nd) {
+			std::size_t i = index.size();
+			index[nd] = low[nd] = i;
+			stack.push(nd);
+			onstack.insert(nd);
+			bool cyclic = false;
+			for (auto& s: nd->succ()) {
+				nptr t = s.first.get().nd;
+				if (t == skip || within.find(t) == within.end())
+					continue;
+				if (t == nd)
+					cyclic = true;
+				if (index.find(t) == index.end()) {
+					visit(t);
+					low[nd] = std::min(low[nd], low[t]);
+				} else if (onstack.find(t) != onstack.end()) {
+					low[nd] = std::min(low[nd], index[t]);
+				}
+			}
+			if (low[nd] != index[nd])
+				return;
+			std::vector<nptr> scc;
+			nptr m;
+			do {
+				m = stack.top();
+				stack.pop();
+				onstack.erase(m);
+				scc.push_back(m);
+			} while (m != nd);
+			if (cyclic || scc.size() > 1)
+				sccs.push_back(scc);
+		};
+
+		for (auto& nd: nds) {
+			if (index.find(nd) == index.end())
+				visit(nd);
+		}
+		return sccs;
+	};
+
+	// returns the node added in front of the loop, the header if none was needed or nullptr if the loop is kept
+	std::function<nptr(std::vector<nptr>)> summarize = [&](std::vector<nptr> loop) -> nptr {
+		std::unordered_set<nptr> within(loop.begin(), loop.end());
+		nptr header = nullptr;
+		std::vector<std::pair<nptr,bool>> entries;
+		for (auto& nd: loop) {
+			if (nd == this->start.nd) {
+				if (header && header != nd)
+					return nullptr;
+				header = nd;
+			}
+			for (auto& pr: nd->pred()) {
+				if (within.find(pr.nd) != within.end())
+					continue;
+				if (header && header != nd)
+					return nullptr;
+				header = nd;
+				entries.push_back(std::make_pair(pr.nd, pr.branchtrue));
+			}
+		}
+		if (!header)
+			return nullptr;
+
+		std::size_t l = limit;
+		auto li = limits.find(header->id());
+		if (li != limits.end())
+			l = li->second;
+		if (!l)
+			return nullptr;
+
+		for (auto& inner: components(loop, header)) {
+			nptr s = summarize(inner);
+			if (!s)
+				return nullptr;
+			if (within.insert(s).second)
+				loop.push_back(s);
+		}
+
+		// longest path from the header to the back edges, one iteration is loop-free now
+		std::unordered_map<nptr,std::size_t> indegree;
+		for (auto& nd: loop) {
+			for (auto& s: nd->succ()) {
+				nptr t = s.first.get().nd;
+				if (t != header && within.find(t) != within.end())
+					indegree[t]++;
+			}
+		}
+		std::unordered_map<nptr,std::pair<unsigned int,double>> worst;
+		unsigned int iteration_cycles = 0;
+		double iteration_dram_cycles = 0.0;
+		std::vector<std::pair<nptr,bool>> back;
+		std::vector<std::shared_ptr<const instr>> body;
+		std::stack<nptr> ready;
+		ready.push(header);
+		std::size_t visited = 0;
+		while (!ready.empty()) {
+			nptr nd = ready.top();
+			ready.pop();
+			visited++;
+			auto w = worst[nd];
+			for (auto i = nd->instrs().begin(); i != nd->instrs().end()-1; i++) {
+				w.first += state::perf::cycles(**i, state::perf::info());
+				w.second += (*i)->dram_cycles();
+			}
+			body.insert(body.end(), nd->instrs().begin(), nd->instrs().end());
+			auto& last = *nd->instrs().back();
+			for (auto& s: nd->succ()) {
+				nptr t = s.first.get().nd;
+				unsigned int c = w.first + state::perf::cycles(last, state::perf::info(), s.second);
+				double d = w.second + last.dram_cycles();
+				if (t == header) {
+					back.push_back(std::make_pair(nd, s.second));
+					iteration_cycles = std::max(iteration_cycles, c);
+					iteration_dram_cycles = std::max(iteration_dram_cycles, d);
+				} else if (within.find(t) != within.end()) {
+					auto& wt = worst[t];
+					wt.first = std::max(wt.first, c);
+					wt.second = std::max(wt.second, d);
+					if (!--indegree[t])
+						ready.push(t);
+				}
+			}
+		}
+		if (visited != loop.size())
+			return nullptr;
+
+		for (auto& b: back)
+			b.first->unlink(b.second);
+		s_summarized_loops.count();
+		if (l == 1)
+			return header;
+
+		nptr sum = std::make_shared<node>(instr::summary::build(header->id(), body, l-1, iteration_cycles, iteration_dram_cycles));
+		for (auto& e: entries) {
+			e.first->unlink(e.second);
+			e.first->link(sum, e.second);
+		}
+		sum->link(header, false);
+		if (this->start.nd == header)
+			this->start.nd = sum;
+		this->nodes.push_back(sum);
+		return sum;
+	};
+
+	for (auto& loop: components(this->nodes, nullptr))
+		summarize(loop);
 }
 
 void cfg::topo_sort() {
-	std::set<nptr> r(this->nodes.begin(), this->nodes.end());
+	std::unordered_set<nptr> r(this->nodes.begin(), this->nodes.end());
 	std::size_t size = this->nodes.size();
 	this->nodes.clear();
 	this->nodes.reserve(size);
 
-	std::map<nptr,std::size_t> visited;
+	std::unordered_map<nptr,std::size_t> visited;
 	std::stack<nptr> stack;
 	stack.push(this->start.nd);
 
@@ -2463,7 +3940,7 @@ void cfg::topo_sort() {
 	}
 
 	if (r.find(this->fin_nd) != r.end())
-		errx(-1, "cfg not loop-free");
+		throw std::invalid_argument("cfg not loop-free");
 
 	for (auto nd: r)
 		this->nodes.push_back(nd);
@@ -2504,7 +3981,7 @@ void cfg::merge_edges() {
 }
 
 void cfg::remove_unreachable() {
-	std::map<nptr,bool> visited;
+	std::unordered_map<nptr,bool> visited;
 	std::stack<nptr> stack;
 	stack.push(this->start.nd);
 
@@ -2545,7 +4022,7 @@ void cfg::create_edges(nptr nd, std::map<std::uint32_t,nptr> map) {
 	switch(nd->exit_type()){
 	case instr::FIN:
 		if (nd != this->fin_nd)
-			errx(-1, "unexpected final node");
+			throw std::invalid_argument("unexpected final node");
 		break;
 	case instr::BRANCH:
 		//push false branche edge
@@ -2563,12 +4040,42 @@ void cfg::create_edges(nptr nd, std::map<std::uint32_t,nptr> map) {
 void cfg::init_nodes(std::string asm_listing) {
 	/*assume instruction in listing will have next format:
 		3  alu[$xfer_0, --, B, $xfer_16]*/
-	std::stringstream ss(asm_listing);
-	for (std::string line; std::getline(ss, line);) {
-		nptr nd = std::make_shared<node>(instr::build_instr(line));
+	std::vector<std::string_view> lines;
+	std::string_view listing = asm_listing;
+	while (!listing.empty()) {
+		std::size_t nl = listing.find('\n');
+		lines.push_back(listing.substr(0, nl));
+		if (nl == std::string_view::npos)
+			break;
+		listing.remove_prefix(nl+1);
+	}
+
+	this->nodes.resize(lines.size());
+	std::size_t chunk = lines.size() / (4 * std::max(PARALLELISM, 1LU)) + 1;
+	thread_pool::group parse(this->thread_pool);
+	// the first malformed line, rethrown on the calling thread
+	std::mutex invalid_mutex;
+	std::exception_ptr invalid = nullptr;
+	for (std::size_t b = 0; b < lines.size(); b += chunk) {
+		std::size_t e = std::min(b + chunk, lines.size());
+		parse.delegate([this,&lines,&invalid_mutex,&invalid,b,e] {
+			try {
+				for (std::size_t i = b; i < e; i++)
+					this->nodes[i] = std::make_shared<node>(instr::build_instr(lines[i]));
+			} catch (const std::invalid_argument&) {
+				std::lock_guard guard(invalid_mutex);
+				if (!invalid)
+					invalid = std::current_exception();
+			}
+		});
+	}
+	parse.wait();
+	if (invalid)
+		std::rethrow_exception(invalid);
+
+	for (nptr nd: this->nodes) {
 		if (nd->id() >= instr::fin::ID)
-			errx(-1, "instr at addr %" PRIu32 " >= %" PRIu32, nd->id(), instr::fin::ID);
-		this->nodes.push_back(nd);
+			throw std::invalid_argument("instr at addr " + std::to_string(nd->id()) + " >= " + std::to_string(instr::fin::ID));
 	}
 
 	/*create final node to which all branches will be linked if label 
@@ -2583,11 +4090,11 @@ void cfg::build_cfg(std::string asm_listing) {
 	std::map<std::uint32_t,nptr> map;
 	for (nptr nd: this->nodes) {
 		if (map.find(nd->id()) != map.end())
-			errx(-1, "multiple instructions at %" PRIu32, nd->id());
+			throw std::invalid_argument("multiple instructions at " + std::to_string(nd->id()));
 		map[nd->id()] = nd;
 	}
 	if (map.find(0) == map.end())
-		errx(-1, "missing instruction at address 0");
+		throw std::invalid_argument("missing instruction at address 0");
 	this->start.nd = map[0];
 
 
@@ -2596,23 +4103,78 @@ void cfg::build_cfg(std::string asm_listing) {
 
 	remove_unreachable();
 	merge_edges();
+	if (o_loop_summary && (UNROLL_LIMIT || !UNROLL_LIMITS.empty()))
+		summarize_loops(UNROLL_LIMIT, UNROLL_LIMITS);
 	if (UNROLL_LIMIT || !UNROLL_LIMITS.empty())
 		unroll(UNROLL_LIMIT, UNROLL_LIMITS);
 }
 
 cfg::cfg(std::string asm_listing, std::ostream &out)
+	: cfg(asm_listing, out, std::make_shared<class thread_pool>(PARALLELISM)) {}
+
+static stats::threadtime& cfg_cputime() {
+	static stats::threadtime cputime("cfg.cputime");
+	return cputime;
+}
+
+static stats::threadtime& threads_cputime() {
+	static stats::threadtime cputime("cfg.threads.cputime");
+	return cputime;
+}
+
+/* The threads are only counted while they surely run, an estimator's pool
+ * or the thread of its run may be gone before the next cfg reports. */
+cfg::cputime::cputime(class thread_pool& pool)
+	: creator(pthread_self()),
+	  threads(pool.thread_handles()) {
+	cfg_cputime().add(this->creator);
+	for (auto handle: this->threads)
+		threads_cputime().add(handle);
+}
+
+cfg::cputime::~cputime() {
+	cfg_cputime().remove(this->creator);
+	for (auto handle: this->threads)
+		threads_cputime().remove(handle);
+}
+
+cfg::cfg(std::string asm_listing, std::ostream &out, std::shared_ptr<class thread_pool> pool)
 	: out(out),
-	  thread_pool(PARALLELISM) {
-	static stats::threadtime cfg_cputime("cfg.cputime", pthread_self());
-	static stats::threadtime threads_cputime("cfg.threads.cputime");
+	  pool(pool),
+	  thread_pool(*pool),
+	  cputime(*pool) {
 	static stats::maxmem maxmem("cfg.maxmem", 0);
 
-	for (auto handle: thread_pool.thread_handles())
-		threads_cputime.add(handle);
-
+	share_settings();
 	build_cfg(asm_listing);
 }
 
+void cfg::settings::apply() const {
+	COST_FIRMWARE = this->cost_firmware;
+	DRAM_COST_FIRMWARE = this->dram_cost_firmware;
+	PARALLELISM = this->parallelism;
+	UNROLL_LIMIT = this->unroll_limit;
+	UNROLL_LIMITS = this->unroll_limits;
+	MIN_PACKETSIZE = this->min_packetsize;
+	MTU = this->mtu;
+	NUM_WORKERS = this->num_workers;
+	PACKET_HEADROOM = this->packet_headroom;
+	CHECKPOINT_INTERVAL = this->checkpoint_interval;
+	CLOCK_FREQUENCY = this->clock_frequency;
+	std::istringstream f(this->feature_values);
+	for (std::string feature; std::getline(f, feature, ',');)
+		features::parse(feature);
+	instr::set_costs(this->costs);
+}
+
+// threads of a shared pool still have the settings of the cfg before
+void cfg::share_settings() {
+	settings s;
+	this->thread_pool.each([s] {
+		s.apply();
+	});
+}
+
 cfg::~cfg() {
 	for (nptr nd: this->nodes)
 		for (auto& pr: nd->pred())
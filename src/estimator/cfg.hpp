@@ -1,29 +1,61 @@
 #pragma once
 
 #include "estimator/state.hpp"
+#include "estimator/instr.hpp"
+#include "estimator/features.hpp"
 #include "estimator/thread_pool.hpp"
+#include "estimator/spill.hpp"
 
 #include <string>
 #include <vector>
 #include <deque>
 #include <map>
+#include <set>
 #include <memory>
+#include <atomic>
+#include <mutex>
+#include <optional>
 #include <ostream>
+#include <fstream>
+#include <functional>
 #include <chrono>
 #include <cinttypes>
 
 
 class cfg {
 public:
-	static unsigned int COST_FIRMWARE;
-	static double DRAM_COST_FIRMWARE;
-	static std::size_t PARALLELISM;
-	static std::size_t UNROLL_LIMIT;
-	static std::map<std::uint32_t,std::size_t> UNROLL_LIMITS;
-	static std::uint32_t MIN_PACKETSIZE;
-	static std::uint32_t MTU;
-	static unsigned int NUM_WORKERS;
-	static std::uint32_t PACKET_HEADROOM;
+	static thread_local unsigned int COST_FIRMWARE;
+	static thread_local double DRAM_COST_FIRMWARE;
+	static thread_local std::size_t PARALLELISM;
+	static thread_local std::size_t UNROLL_LIMIT;
+	static thread_local std::map<std::uint32_t,std::size_t> UNROLL_LIMITS;
+	static thread_local std::uint32_t MIN_PACKETSIZE;
+	static thread_local std::uint32_t MTU;
+	static thread_local unsigned int NUM_WORKERS;
+	static thread_local std::uint32_t PACKET_HEADROOM;
+	static thread_local unsigned int CHECKPOINT_INTERVAL;
+	static thread_local unsigned int CLOCK_FREQUENCY;
+
+	/* The configuration above, the features and the instruction costs are
+	 * per thread, so differently configured cfgs may run at once. A cfg
+	 * takes the configuration of the thread creating it to its threads. */
+	struct settings {
+		unsigned int cost_firmware = COST_FIRMWARE;
+		double dram_cost_firmware = DRAM_COST_FIRMWARE;
+		std::size_t parallelism = PARALLELISM;
+		std::size_t unroll_limit = UNROLL_LIMIT;
+		std::map<std::uint32_t,std::size_t> unroll_limits = UNROLL_LIMITS;
+		std::uint32_t min_packetsize = MIN_PACKETSIZE;
+		std::uint32_t mtu = MTU;
+		unsigned int num_workers = NUM_WORKERS;
+		std::uint32_t packet_headroom = PACKET_HEADROOM;
+		unsigned int checkpoint_interval = CHECKPOINT_INTERVAL;
+		unsigned int clock_frequency = CLOCK_FREQUENCY;
+		std::string feature_values = features::values();
+		instr::cost_table costs = instr::costs();
+
+		void apply() const;
+	};
 
 	struct DOT;
 	struct LONGEST_PATH;
@@ -145,11 +177,14 @@ public:
 		virtual pptr check() = 0;
 		virtual bool is_same(pptr o) const = 0;
 		virtual pptr merge(pptr o) const = 0;
+		// a lightweight replacement keeping the path on disk, if it can be evicted
+		virtual pptr evict(class spill& tier) { return nullptr; }
 
 		class none;
 		template<class S> class withstate;
 		class impossible;
 		class possible;
+		class spilled;
 		using iptr = std::shared_ptr<path::impossible>;
 	};
 
@@ -207,8 +242,11 @@ private:
 			}
 		};
 	private:
-		std::deque<pptr> paths = {};
+		// allocated by the first path, an empty std::deque already holds a
+		// block, and most edges of an unrolled cfg are never reached
+		std::optional<std::deque<pptr>> paths = {};
 		sizet count = 0;
+		const std::deque<pptr>& queue() const;
 	public:
 		pathq() = default;
 		pathq(const pptr& p);
@@ -222,6 +260,7 @@ private:
 		pptr front() const;
 		pptr back() const;
 		pptr take();
+		pathq evict(class spill& tier, sizet from) const;
 	};
 
 	class mpathq {
@@ -277,6 +316,7 @@ private:
 	template<typename... S> class rmax;
 	template<typename... S> class ipathq;
 	template<typename... S> class itpathq;
+	template<typename S> class kpaths;
 
 	struct instr_data {
 		std::shared_ptr<const instr> n;
@@ -303,20 +343,96 @@ private:
 		template<typename S> struct _d {
 			pathq q = {};
 			mpathq mq = mpathq();
+			// longest suffix to fin ignoring data constraints, overall and per packet size
+			typename S::value_type suffix = S::MIN;
+			std::map<std::uint32_t,typename S::value_type> suffixes = {};
 		};
 		template<typename S> auto& d() { return std::get<_d<S>>(this->td); };
+		template<typename S> const auto& d() const { return std::get<_d<S>>(this->td); };
 		template<typename S> auto& q(const S&) { return d<S>().q; };
+		template<typename S> const auto& q(const S&) const { return d<S>().q; };
 		template<typename S> auto& mq(const S&) { return d<S>().mq; };
+		template<typename S> const auto& mq(const S&) const { return d<S>().mq; };
 		std::tuple<_d<path::MAX_CYCLES>,_d<path::DRAM_CYCLES>> td = {};
 	};
 
 	std::ostream& out;
 	std::chrono::time_point<std::chrono::steady_clock> start_time = std::chrono::steady_clock::now();
 	unsigned long index = 0;
+	// outlives the nodes, whose queues may hold spilled paths releasing their records
+	class spill spill;
 	std::vector<nptr> nodes;
 	succ_data start;
 	nptr fin_nd;
-	class thread_pool thread_pool;
+	// shared by the cfgs of a batch, keeping the z3 processes of its threads
+	std::shared_ptr<class thread_pool> pool;
+	class thread_pool& thread_pool;
+	// counts the cpu time of the creating thread and the pool while the cfg lives
+	struct cputime {
+		std::thread::native_handle_type creator;
+		std::vector<std::thread::native_handle_type> threads;
+		cputime(class thread_pool& pool);
+		~cputime();
+	} cputime;
+	std::atomic<bool> spilling = false;
+	struct checkpoint {
+		std::string file = {};
+		std::string fingerprint = {};
+		std::chrono::time_point<std::chrono::steady_clock> written = std::chrono::steady_clock::now();
+		// bound of the last reported path and the paths reported with it
+		double bound = 0;
+		std::vector<std::string> ties = {};
+		// paths reported before the checkpoint resumed from
+		bool replaying = false;
+		double resumed_bound = 0;
+		std::multiset<std::string> resumed_ties = {};
+		// outcomes of the checks, including those of the run resumed from
+		std::mutex mutex = {};
+		std::vector<std::string> settled = {};
+		std::set<std::string> resumed_unsat = {};
+		std::map<std::string,std::uint32_t> resumed_sat = {};
+	} checkpoint = {};
+	/* results of earlier runs keyed by a hash of the code and structure
+	 * leading to an edge, which stays the same when only code after it or
+	 * in other branches changes */
+	struct cache {
+		std::string file = {};
+		std::mutex mutex = {};
+		std::map<nptr,std::string> hashes = {};
+		std::map<std::pair<std::string,bool>,std::pair<std::optional<bool>,std::uint32_t>> minimized = {};
+		std::set<std::pair<std::string,bool>> sat_checks = {};
+	} cache = {};
+	struct sweep {
+		bool enabled = false;
+		std::mutex mutex = {};
+		std::set<std::string> unsat = {};
+	} sweep = {};
+	/* the paths reported by a bit-rate enumeration with the most cycles per
+	 * minimal packet size, the longest suffixes per size class and the
+	 * bound on all paths not reported yet */
+	struct curve {
+		bool enabled = false;
+		std::map<std::uint32_t,std::tuple<unsigned int,double>> reported = {};
+		std::map<std::uint32_t,std::tuple<unsigned int,double>> suffixes = {};
+		double bound = 0;
+	} curve = {};
+	// bounds and paths streamed as JSON lines
+	struct trajectory {
+		std::ofstream file = {};
+		std::function<void(const std::string&)> progress = nullptr;
+		// the bound holding for all paths, by rate, also kept without streaming
+		std::map<std::string,std::string> guaranteed = {};
+	} trajectory = {};
+	std::chrono::time_point<std::chrono::steady_clock> deadline = std::chrono::time_point<std::chrono::steady_clock>::max();
+	bool stop_at_deadline = false;
+	std::atomic<bool> cancelled = false;
+	bool stopped = false;
+	struct combined {
+		bool enabled = false;
+		// rate of the report being written
+		const char* rate = nullptr;
+		std::mutex checking[64] = {};
+	} combined = {};
 
 	void init_nodes(std::string asm_listing);
 	void create_edges(nptr nd, std::map<std::uint32_t,nptr> map);
@@ -325,23 +441,43 @@ private:
 	bool is_in_loop(nptr nd);
 	std::set<nptr> loopfree_nodes();
 	void unroll(std::size_t limit, const std::map<std::uint32_t,std::size_t>& limits);
+	void summarize_loops(std::size_t limit, const std::map<std::uint32_t,std::size_t>& limits);
 	void topo_sort();
 	void overestimate_cycles();
 	template<typename... S> mpathq::sizev propagate_sizes();
+	template<typename S> static typename S::value_type weight(const succ_data& s, bool branchtrue);
+	template<typename... S> void longest_suffixes();
+	template<typename S> std::vector<tratio<S>> suffix_bounds(const mpathq::sizev& sizes);
 	void link_nodes(nptr src, std::uint32_t dst, std::map<std::uint32_t,nptr>& map, bool branchtrue);
 	void build_cfg(std::string asm_listing);
 	state::exec initial_state();
 	template<typename S> pathq next_k(std::size_t k);
 	template<typename S> mpathq next_k(const mpathq::sizev& k);
+	pathq evict(const pathq& q, pathq::sizet ahead, pathq::sizet hot);
 	template<typename S> void push_impossible();
 	template<typename S> void push_mimpossible();
 	template<typename... S> void report_max(const vmax<S...>& max);
 	template<typename... S> void report_max(const rmax<S...>& max);
 	void report_path(const pptr p);
+	void stream(const char* type, const std::string& fields);
+	void stream(const std::string& line);
+	bool past_deadline() const;
+	std::size_t next_batch(std::size_t k, std::chrono::steady_clock::duration took, bool available);
+	template<typename S> void curve_suffixes(const mpathq::sizev& sizes);
+	template<typename... S> void curve_path(const pptr& p);
+	void report_curve();
+	bool replayed(double bound, const pptr& p);
+	void save_checkpoint(double bound, const pptr& p);
+	void share_settings();
+	void hash_nodes();
+	void save_cache();
 	template<typename S> auto underestimate_packetrate();
 	template<typename S> auto underestimate_bitrate(const mpathq::sizev& sizes);
+	pptr check(const pptr& p);
+	pptr check_settled(const pptr& p);
 	template<typename... S> void enumerate_by_packetrate(std::size_t count);
 	template<typename... S> void enumerate_by_bitrate(std::size_t count);
+	template<typename... S> void enumerate_by_rates(std::size_t count);
 
 public:
 	void enumerate_by_proc_packetrate(std::size_t count);
@@ -350,11 +486,24 @@ public:
 	void enumerate_by_proc_bitrate(std::size_t count);
 	void enumerate_by_dram_bitrate(std::size_t count);
 	void enumerate_by_bitrate(std::size_t count);
+	void enumerate_by_rates(std::size_t count);
+	void enumerate_curve(std::size_t count);
 	void save_dot_graph() const;
 	void static_analysis(bool sat_check);
 	void report_timeout();
+	void resume(const std::string& file, const std::string& fingerprint);
+	void write_checkpoint(bool interrupted);
+	void use_cache(const std::string& file);
+	void configure(unsigned int workers, unsigned int cost, std::uint32_t mtu);
+	void stream_bounds(const std::string& file);
+	void stream_bounds(std::function<void(const std::string&)> progress);
+	void set_deadline(std::chrono::time_point<std::chrono::steady_clock> deadline, bool stop=false);
+	void cancel();
+	bool finished() const;
+	std::string final_bound() const;
 
 	cfg(std::string nfp_asm_listing, std::ostream &out);
+	cfg(std::string nfp_asm_listing, std::ostream &out, std::shared_ptr<class thread_pool> pool);
 	~cfg();
 };
 
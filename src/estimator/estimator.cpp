@@ -0,0 +1,167 @@
+#include "estimator/estimator.hpp"
+#include "estimator/cfg.hpp"
+#include "estimator/instr.hpp"
+#include "estimator/features.hpp"
+#include "estimator/thread_pool.hpp"
+
+#include <string>
+#include <sstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+
+struct estimator::analysis {
+	std::string asm_listing;
+	config c;
+	callbacks cb;
+	cfg::settings settings = {};
+	// kept across runs, and with it the z3 processes of its threads
+	std::shared_ptr<class thread_pool> pool = nullptr;
+	std::mutex mutex = {};
+	cfg* running = nullptr;
+	bool cancelled = false;
+
+	analysis(const std::string& asm_listing, const config& c, const callbacks& cb)
+		: asm_listing(asm_listing),
+		  c(c),
+		  cb(cb) {}
+};
+
+estimator::estimator(const std::string& asm_listing, const config& c)
+	: estimator(asm_listing, c, callbacks()) {}
+
+estimator::estimator(const std::string& asm_listing, const config& c, const callbacks& cb)
+	: a(std::make_unique<analysis>(asm_listing, c, cb)) {
+	// a new thread starts from the defaults, whatever the calling thread configured
+	std::exception_ptr invalid = nullptr;
+	std::thread([this, &c, &invalid] {
+		try {
+			if (c.workers)
+				cfg::NUM_WORKERS = *c.workers;
+			if (c.cost_firmware)
+				cfg::COST_FIRMWARE = *c.cost_firmware;
+			if (c.mtu)
+				cfg::MTU = *c.mtu;
+			if (c.threads)
+				cfg::PARALLELISM = *c.threads;
+			if (c.unroll_limit)
+				cfg::UNROLL_LIMIT = *c.unroll_limit;
+			for (auto [id, limit]: c.unroll_limits)
+				cfg::UNROLL_LIMITS[id] = limit;
+			for (auto& f: c.features) {
+				if (!features::parse(f))
+					throw std::invalid_argument("invalid feature: " + f);
+			}
+			if (!c.costs.empty()) {
+				std::istringstream costs(c.costs);
+				instr::load_costs(costs);
+			}
+			this->a->settings = cfg::settings();
+		} catch (const std::invalid_argument&) {
+			invalid = std::current_exception();
+		}
+	}).join();
+	if (invalid)
+		std::rethrow_exception(invalid);
+}
+
+estimator::~estimator() = default;
+
+/* Runs the analysis on the calling thread and the threads of the
+ * estimator, passing its report to the result callback. Returns false if
+ * it timed out or was cancelled. */
+bool estimator::run() {
+	analysis& a = *this->a;
+	// also when a malformed listing throws
+	struct restore {
+		cfg::settings caller = {};
+		~restore() {
+			this->caller.apply();
+		}
+	} restore;
+	a.settings.apply();
+	if (!a.pool)
+		a.pool = std::make_shared<class thread_pool>(cfg::PARALLELISM);
+
+	std::ostringstream out;
+	cfg g(a.asm_listing, out, a.pool);
+	if (!a.c.cache.empty())
+		g.use_cache(a.c.cache);
+	if (a.cb.progress)
+		g.stream_bounds(a.cb.progress);
+	if (a.c.timeout.count())
+		g.set_deadline(std::chrono::steady_clock::now() + a.c.timeout, true);
+
+	{
+		// a cancel before the run stops it right away, one during the run only stops this run
+		struct running {
+			analysis& a;
+			running(analysis& a, cfg& g)
+				: a(a) {
+				std::lock_guard guard(a.mutex);
+				if (a.cancelled)
+					g.cancel();
+				a.cancelled = false;
+				a.running = &g;
+			}
+			~running() {
+				std::lock_guard guard(this->a.mutex);
+				this->a.running = nullptr;
+				this->a.cancelled = false;
+			}
+		} running(a, g);
+
+		int static_analysis = a.c.static_analysis;
+		if (static_analysis == -1)
+			static_analysis = std::min((a.c.mode+2)/3, 2);
+		if (static_analysis >= 1)
+			g.static_analysis(static_analysis >= 2);
+
+		switch (a.c.mode) {
+		case DOT:
+			g.save_dot_graph();
+			break;
+		case PACKETRATE:
+			g.enumerate_by_packetrate(a.c.count);
+			break;
+		case PROC_PACKETRATE:
+			g.enumerate_by_proc_packetrate(a.c.count);
+			break;
+		case DRAM_PACKETRATE:
+			g.enumerate_by_dram_packetrate(a.c.count);
+			break;
+		case BITRATE:
+			g.enumerate_by_bitrate(a.c.count);
+			break;
+		case PROC_BITRATE:
+			g.enumerate_by_proc_bitrate(a.c.count);
+			break;
+		case DRAM_BITRATE:
+			g.enumerate_by_dram_bitrate(a.c.count);
+			break;
+		case RATES:
+			g.enumerate_by_rates(a.c.count);
+			break;
+		case CURVE:
+			g.enumerate_curve(a.c.count);
+			break;
+		}
+	}
+
+	bool finished = g.finished();
+	if (a.cb.result)
+		a.cb.result(out.str(), finished);
+	return finished;
+}
+
+// from any thread, stops the run after its current batch of paths, or the next run right away
+void estimator::cancel() {
+	std::lock_guard guard(this->a->mutex);
+	this->a->cancelled = true;
+	if (this->a->running)
+		this->a->running->cancel();
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+#include <optional>
+#include <chrono>
+#include <cstdint>
+
+/* Embeds the analyses of nfp-estimator in other programs. Every estimator
+ * has its own configuration, threads and z3 processes, so several may run
+ * at once in one process. The stats counters and the debug switches of -A,
+ * -I and -Z stay shared by the whole process. Bad input is thrown as
+ * std::invalid_argument, by the constructor for an unknown feature or a
+ * malformed cost table, by run() for a malformed listing. Other errors,
+ * e.g. of z3, exit as in nfp-estimator. */
+class estimator {
+public:
+	enum mode {
+		DOT,
+		PACKETRATE,
+		PROC_PACKETRATE,
+		DRAM_PACKETRATE,
+		BITRATE,
+		PROC_BITRATE,
+		DRAM_BITRATE,
+		RATES,
+		CURVE,
+	};
+
+	// the options of nfp-estimator, unset ones keep its defaults
+	struct config {
+		enum mode mode = BITRATE;
+		int static_analysis = -1;                             // -L, by default depending on the mode
+		std::size_t count = -1;                               // -c
+		std::optional<unsigned int> workers = {};             // -w
+		std::optional<unsigned int> cost_firmware = {};       // -C
+		std::optional<std::uint32_t> mtu = {};                // -M
+		std::optional<std::size_t> threads = {};              // -t
+		std::optional<std::size_t> unroll_limit = {};         // -U
+		std::map<std::uint32_t,std::size_t> unroll_limits = {};
+		std::vector<std::string> features = {};               // -F
+		std::string costs = {};                               // contents of a -K table
+		std::string cache = {};                               // -H
+		std::chrono::steady_clock::duration timeout = {};     // -T, zero for none
+	};
+
+	struct callbacks {
+		// the JSON lines -J streams, as bounds improve and paths are found
+		std::function<void(const std::string& line)> progress = nullptr;
+		// the report nfp-estimator writes, and whether the analysis ran to its end
+		std::function<void(const std::string& report, bool finished)> result = nullptr;
+	};
+
+	estimator(const std::string& asm_listing, const config& c);
+	estimator(const std::string& asm_listing, const config& c, const callbacks& cb);
+	~estimator();
+
+	bool run();
+	void cancel();
+
+private:
+	struct analysis;
+	std::unique_ptr<analysis> a;
+};
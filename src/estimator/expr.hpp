@@ -2,6 +2,8 @@
 
 #include <memory>
 #include <limits>
+#include <optional>
+#include <unordered_map>
 #include <string>
 #include <set>
 #include <map>
@@ -21,6 +23,8 @@ private:
 public:
 	template<std::uint8_t B> struct undefined;
 	template<std::uint8_t A, std::uint8_t V> struct undefined_array;
+	struct bits;
+	class ranges;
 	template<class R, class E=std::shared_ptr<const R>> struct unary;
 	template<class R, class A=std::shared_ptr<const R>, class B=A> struct binary;
 	struct decl;
@@ -279,6 +283,11 @@ public:
 		return std::make_shared<const struct expr::undefined<B>>(name, e);
 	}
 
+	template<std::uint8_t B>
+	static expr::bvptr<B> undef(const expr::bits& known) {
+		return std::make_shared<const struct expr::undefined<B>>(known);
+	}
+
 	template<std::uint8_t A, std::uint8_t V>
 	static expr::aptr<A,V> undef_array() {
 		static std::shared_ptr<const struct expr::undefined_array<A,V>> undef = std::make_shared<const struct undefined_array<A,V>>();
@@ -445,8 +454,136 @@ public:
 	virtual bool operator==(const expr& o) const = 0;
 	virtual void defs(expr::defs& d) const = 0;
 
+	// abstract value, memoized in r as subterms are shared
+	bits range(ranges& r) const;
+	virtual bits bounds(ranges& r) const;
+	// truth value if it follows from the abstract values
+	virtual std::optional<bool> decide(ranges& r) const {
+		return {};
+	}
+};
+
+/* abstract value of a bitvector, an unsigned interval together with the
+ * bits known to be 0 or 1, values wider than 64 bits are not tracked */
+struct expr::bits {
+	std::uint8_t width;
+	std::uint64_t zeros;
+	std::uint64_t ones;
+	std::uint64_t lo;
+	std::uint64_t hi;
+
+	static std::uint64_t mask(unsigned int width) {
+		return width >= 64 ? ~0LU : (1LU<<width)-1;
+	}
+	static unsigned int length(std::uint64_t v) {
+		return v ? 64 - __builtin_clzll(v) : 0;
+	}
+	static unsigned int trailing(std::uint64_t v) {
+		return ~v ? __builtin_ctzll(~v) : 64;
+	}
+	static std::uint64_t rotl(std::uint64_t v, unsigned int i, unsigned int width) {
+		i %= width;
+		if (!i)
+			return v;
+		return ((v << i) | (v >> (width - i))) & mask(width);
+	}
+	static bits top(std::uint8_t width) {
+		return bits{width, 0, 0, 0, mask(width)};
+	}
+	static bits constant(std::uint8_t width, std::uint64_t v) {
+		v &= mask(width);
+		return bits{width, ~v & mask(width), v, v, v};
+	}
+
+	bool tracked() const {
+		return this->width <= 64;
+	}
+	bool is_top() const {
+		return !tracked() || (!this->zeros && !this->ones && !this->lo && this->hi == mask(this->width));
+	}
+	std::optional<std::uint64_t> value() const {
+		if (tracked() && this->lo == this->hi)
+			return this->lo;
+		return {};
+	}
+	bool disjoint(const bits& o) const {
+		if (!tracked() || this->width != o.width)
+			return false;
+		return this->hi < o.lo || o.hi < this->lo || (this->ones & o.zeros) || (this->zeros & o.ones);
+	}
+	bool operator==(const bits& o) const {
+		return this->width == o.width && this->zeros == o.zeros && this->ones == o.ones && this->lo == o.lo && this->hi == o.hi;
+	}
+
+	// tightens the interval by the known bits and vice versa
+	bits normalize() const {
+		if (!tracked())
+			return top(this->width);
+		std::uint64_t m = mask(this->width);
+		bits r{this->width, this->zeros & m, this->ones & m, this->lo, std::min(this->hi, m)};
+		if (r.zeros & r.ones)
+			return top(this->width);
+		r.lo = std::max(r.lo, r.ones);
+		r.hi = std::min(r.hi, ~r.zeros & m);
+		if (r.lo > r.hi)
+			return top(this->width);
+		// bits above the highest one in which lo and hi differ are fixed
+		std::uint64_t fixed = ~mask(length(r.lo ^ r.hi)) & m;
+		r.ones |= r.lo & fixed;
+		r.zeros |= ~r.lo & fixed;
+		return r;
+	}
+	bits join(const bits& o) const {
+		if (!tracked() || this->width != o.width)
+			return top(this->width);
+		return bits{this->width, this->zeros & o.zeros, this->ones & o.ones, std::min(this->lo, o.lo), std::max(this->hi, o.hi)}.normalize();
+	}
+	// join that moves growing bounds to the next power of two, so that
+	// repeated merges change each bound at most width times
+	bits widen(const bits& o) const {
+		bits j = join(o);
+		if (!tracked() || j == *this)
+			return j;
+		if (j.lo < this->lo)
+			j.lo = j.lo ? 1LU << (length(j.lo) - 1) : 0;
+		if (j.hi > this->hi)
+			j.hi = mask(length(j.hi));
+		return j.normalize();
+	}
 };
 
+/* abstract values of the expressions of one state, variables that are not
+ * bound are unconstrained */
+class expr::ranges {
+	friend struct expr;
+	std::unordered_map<const expr*,bits> memo = {};
+	std::map<std::string,bits> variables = {};
+public:
+	void bind(const std::string& declname, const bits& b) {
+		this->variables[declname] = b;
+	}
+	std::optional<bits> variable(const std::string& declname) const {
+		auto v = this->variables.find(declname);
+		if (v == this->variables.end())
+			return {};
+		return v->second;
+	}
+};
+
+inline expr::bits expr::range(ranges& r) const {
+	auto m = r.memo.find(this);
+	if (m != r.memo.end())
+		return m->second;
+	bits b = bounds(r);
+	r.memo.emplace(this, b);
+	return b;
+}
+
+// booleans and arrays are not tracked
+inline expr::bits expr::bounds(ranges& r) const {
+	return bits::top(std::numeric_limits<std::uint8_t>::max());
+}
+
 class expr::virtual_shared : public std::enable_shared_from_this<virtual_shared> {
 public:
 	virtual ~virtual_shared() = default;
@@ -674,6 +811,9 @@ struct expr::boolean : public expr::lexpr {
 	}
 	void defs(class expr::defs& d) const override {
 	}
+	std::optional<bool> decide(expr::ranges& r) const override {
+		return this->value;
+	}
 
 	bool t_lor(expr::lptr& r, expr::lptr o) const override {
 		if (this->value) {
@@ -706,6 +846,12 @@ struct expr::negation : public lunary {
 	std::string name() const override {
 		return "not";
 	};
+	std::optional<bool> decide(expr::ranges& r) const override {
+		std::optional<bool> d = this->e->decide(r);
+		if (d)
+			return !*d;
+		return {};
+	}
 };
 
 template<class T>
@@ -714,6 +860,15 @@ struct expr::equality : public binary<lexpr,T> {
 	std::string name() const override {
 		return "=";
 	}
+	std::optional<bool> decide(expr::ranges& r) const override {
+		expr::bits a = this->a->range(r);
+		expr::bits b = this->b->range(r);
+		if (a.value() && a.value() == b.value())
+			return true;
+		if (a.disjoint(b))
+			return false;
+		return {};
+	}
 };
 
 struct expr::loring : public lbinary {
@@ -721,6 +876,15 @@ struct expr::loring : public lbinary {
 	std::string name() const override {
 		return "or";
 	}
+	std::optional<bool> decide(expr::ranges& r) const override {
+		std::optional<bool> a = this->a->decide(r);
+		std::optional<bool> b = this->b->decide(r);
+		if ((a && *a) || (b && *b))
+			return true;
+		if (a && b)
+			return false;
+		return {};
+	}
 };
 
 struct expr::landing : public lbinary {
@@ -728,6 +892,15 @@ struct expr::landing : public lbinary {
 	std::string name() const override {
 		return "and";
 	}
+	std::optional<bool> decide(expr::ranges& r) const override {
+		std::optional<bool> a = this->a->decide(r);
+		std::optional<bool> b = this->b->decide(r);
+		if ((a && !*a) || (b && !*b))
+			return false;
+		if (a && b)
+			return true;
+		return {};
+	}
 };
 
 template<class T>
@@ -774,6 +947,21 @@ struct expr::ifthenelse : public T {
 		}
 		d.add_expr(this->shared_expr_from_this());
 	}
+	expr::bits bounds(expr::ranges& r) const override {
+		std::optional<bool> d = this->l->decide(r);
+		if (d)
+			return (*d ? this->a : this->b)->range(r);
+		return this->a->range(r).join(this->b->range(r));
+	}
+	std::optional<bool> decide(expr::ranges& r) const override {
+		std::optional<bool> d = this->l->decide(r);
+		if (d)
+			return (*d ? this->a : this->b)->decide(r);
+		std::optional<bool> a = this->a->decide(r);
+		if (a && a == this->b->decide(r))
+			return a;
+		return {};
+	}
 };
 
 
@@ -793,10 +981,19 @@ struct expr::bvexpr : public expr, public virtual virtual_shared {
 	virtual std::string minimize() const {
 		return "(minimize " + this->str() + ")\n";
 	}
-	virtual expr::bvptr<B> static_merge(expr::bvptr<B> o) const {
+	expr::bits bounds(expr::ranges& r) const override {
+		return expr::bits::top(B);
+	}
+	/* differing values become undefined, keeping the join of the abstract
+	 * values of both sides, mine and theirs are the ranges of each side */
+	virtual expr::bvptr<B> static_merge(expr::bvptr<B> o, expr::ranges& mine, expr::ranges& theirs, bool widen) const {
 		if (*this == *o)
 			return this->shared_bvexpr_from_this();
-		return undef<B>();
+		expr::bits a = this->range(mine);
+		expr::bits j = widen ? a.widen(o->range(theirs)) : a.join(o->range(theirs));
+		if (j.is_top())
+			return undef<B>();
+		return undef<B>(j);
 	}
 };
 
@@ -804,12 +1001,15 @@ template<std::uint8_t B>
 struct expr::undefined : public bvexpr<B> {
 	std::string name;
 	expr::eptr e;
+	expr::bits known;
 	undefined() :
-		name(""), e(nullptr) {}
+		name(""), e(nullptr), known(expr::bits::top(B)) {}
 	undefined(const std::string& name)
-		: name(name), e(nullptr) {}
+		: name(name), e(nullptr), known(expr::bits::top(B)) {}
 	undefined(const std::string& name, expr::eptr e)
-		: name(name), e(e) {}
+		: name(name), e(e), known(expr::bits::top(B)) {}
+	undefined(const expr::bits& known)
+		: name(""), e(nullptr), known(known) {}
 	std::string str() const override {
 		std::string str = "(undefined";
 		if (!name.empty())
@@ -841,6 +1041,9 @@ struct expr::undefined : public bvexpr<B> {
 		if (e)
 			e->defs(d);
 	}
+	expr::bits bounds(expr::ranges& r) const override {
+		return this->known;
+	}
 };
 
 template<std::uint8_t A, std::uint8_t V>
@@ -921,6 +1124,9 @@ struct expr::bitvector : public bvexpr<B> {
 	}
 	void defs(class expr::defs& d) const override {
 	}
+	expr::bits bounds(expr::ranges& r) const override {
+		return expr::bits::constant(B, this->value);
+	}
 };
 
 template<>
@@ -1036,6 +1242,12 @@ struct expr::bvvariable : public decl, public bvexpr<B> {
 	void defs(class expr::defs& d) const override {
 		decl::defs(d);
 	}
+	expr::bits bounds(expr::ranges& r) const override {
+		std::optional<expr::bits> v = r.variable(this->declname);
+		if (v)
+			return *v;
+		return expr::bits::top(B);
+	}
 };
 
 template<std::uint8_t A, std::uint8_t V>
@@ -1049,7 +1261,7 @@ struct expr::bvarray : public expr, public virtual virtual_shared {
 	std::string type() const override {
 		return "(Array (_ BitVec " + std::to_string(A) + ") (_ BitVec " + std::to_string(V) + "))";
 	}
-	virtual expr::aptr<A,V> static_merge(expr::aptr<A,V> o) const {
+	virtual expr::aptr<A,V> static_merge(expr::aptr<A,V> o, expr::ranges& mine, expr::ranges& theirs, bool widen) const {
 		if (*this == *o)
 			return this->shared_bvarray_from_this();
 		return undef_array<A,V>();
@@ -1321,13 +1533,13 @@ struct expr::concrete_storing : public expr::bvarray<A,V> {
 		}
 		d.add_expr(this->shared_bvarray_from_this());
 	}
-	expr::aptr<A,V> static_merge(expr::aptr<A,V> o) const override {
+	expr::aptr<A,V> static_merge(expr::aptr<A,V> o, expr::ranges& mine, expr::ranges& theirs, bool widen) const override {
 		if (*this == *o)
 			return this->shared_bvarray_from_this();
 		std::shared_ptr<const expr::concrete_storing<A,V>> s = std::dynamic_pointer_cast<const expr::concrete_storing<A,V>>(o);
 		if (!s)
 			return undef_array<A,V>();
-		expr::aptr<A,V> a = this->array->static_merge(s->array);
+		expr::aptr<A,V> a = this->array->static_merge(s->array, mine, theirs, widen);
 		std::map<const expr::bitvector<A>,expr::bvptr<V>> m;
 		auto i = this->map.begin();
 		auto j = s->map.begin();
@@ -1345,7 +1557,7 @@ struct expr::concrete_storing : public expr::bvarray<A,V> {
 				m[j->first] = undef<V>();
 				j++;
 			} else {
-				m[i->first] = i->second->static_merge(j->second);
+				m[i->first] = i->second->static_merge(j->second, mine, theirs, widen);
 				i++;
 				j++;
 			}
@@ -1381,6 +1593,21 @@ struct expr::extraction : public bvexpr<S-E+1> {
 	void defs(class expr::defs& d) const override {
 		this->e->defs(d);
 	}
+	expr::bits bounds(expr::ranges& r) const override {
+		if constexpr (B > 64) {
+			return expr::bits::top(S-E+1);
+		} else {
+			expr::bits e = this->e->range(r);
+			std::uint64_t m = expr::bits::mask(S-E+1);
+			expr::bits x{S-E+1, (e.zeros >> E) & m, (e.ones >> E) & m, 0, m};
+			// the interval carries over if no bits above S are cut off
+			if (S+1 >= B || !(e.hi >> ((S+1) % 64))) {
+				x.lo = e.lo >> E;
+				x.hi = e.hi >> E;
+			}
+			return x.normalize();
+		}
+	}
 };
 
 template<std::uint8_t B>
@@ -1389,6 +1616,13 @@ struct expr::bvnegation : public bvunary<B> {
 	std::string name() const override {
 		return "bvnot";
 	}
+	expr::bits bounds(expr::ranges& r) const override {
+		expr::bits e = this->e->range(r);
+		if (!e.tracked())
+			return e;
+		std::uint64_t m = expr::bits::mask(B);
+		return expr::bits{B, e.ones, e.zeros, m - e.hi, m - e.lo};
+	}
 };
 
 template<std::uint8_t A, std::uint8_t B>
@@ -1397,13 +1631,22 @@ struct expr::concatenation : public bvbinary<A,B,A+B> {
 	std::string name() const override {
 		return "concat";
 	}
-	expr::bvptr<A+B> static_merge(expr::bvptr<A+B> o) const override {
+	expr::bits bounds(expr::ranges& r) const override {
+		if constexpr (A+B > 64) {
+			return expr::bits::top(A+B);
+		} else {
+			expr::bits a = this->a->range(r);
+			expr::bits b = this->b->range(r);
+			return expr::bits{A+B, (a.zeros << B) | b.zeros, (a.ones << B) | b.ones, (a.lo << B) | b.lo, (a.hi << B) | b.hi}.normalize();
+		}
+	}
+	expr::bvptr<A+B> static_merge(expr::bvptr<A+B> o, expr::ranges& mine, expr::ranges& theirs, bool widen) const override {
 		if (*this == *o)
 			return this->shared_bvexpr_from_this();
 		std::shared_ptr<const concatenation<A,B>> c = std::dynamic_pointer_cast<const concatenation<A,B>>(o);
 		if (!c)
-			return undef<A+B>();
-		return concat(this->a->static_merge(c->a), this->b->static_merge(c->b));
+			return bvexpr<A+B>::static_merge(o, mine, theirs, widen);
+		return concat(this->a->static_merge(c->a, mine, theirs, widen), this->b->static_merge(c->b, mine, theirs, widen));
 	}
 };
 
@@ -1413,6 +1656,15 @@ struct expr::bvcomparison : public bvbinary<B,B,1> {
 	std::string name() const override {
 		return "bvcomp";
 	}
+	expr::bits bounds(expr::ranges& r) const override {
+		expr::bits a = this->a->range(r);
+		expr::bits b = this->b->range(r);
+		if (a.value() && a.value() == b.value())
+			return expr::bits::constant(1, 1);
+		if (a.disjoint(b))
+			return expr::bits::constant(1, 0);
+		return expr::bits::top(1);
+	}
 };
 
 template<std::uint8_t B>
@@ -1421,6 +1673,17 @@ struct expr::bvultcomparison : public binary<lexpr,bvptr<B>> {
 	std::string name() const override {
 		return "bvult";
 	}
+	std::optional<bool> decide(expr::ranges& r) const override {
+		expr::bits a = this->a->range(r);
+		expr::bits b = this->b->range(r);
+		if (!a.tracked())
+			return {};
+		if (a.hi < b.lo)
+			return true;
+		if (a.lo >= b.hi)
+			return false;
+		return {};
+	}
 };
 
 template<std::uint8_t B>
@@ -1429,6 +1692,17 @@ struct expr::bvulecomparison : public binary<lexpr,bvptr<B>> {
 	std::string name() const override {
 		return "bvule";
 	}
+	std::optional<bool> decide(expr::ranges& r) const override {
+		expr::bits a = this->a->range(r);
+		expr::bits b = this->b->range(r);
+		if (!a.tracked())
+			return {};
+		if (a.hi <= b.lo)
+			return true;
+		if (a.lo > b.hi)
+			return false;
+		return {};
+	}
 };
 
 template<std::uint8_t B>
@@ -1437,6 +1711,17 @@ struct expr::bvugtcomparison : public binary<lexpr,bvptr<B>> {
 	std::string name() const override {
 		return "bvugt";
 	}
+	std::optional<bool> decide(expr::ranges& r) const override {
+		expr::bits a = this->a->range(r);
+		expr::bits b = this->b->range(r);
+		if (!a.tracked())
+			return {};
+		if (a.lo > b.hi)
+			return true;
+		if (a.hi <= b.lo)
+			return false;
+		return {};
+	}
 };
 
 template<std::uint8_t B>
@@ -1445,6 +1730,17 @@ struct expr::bvugecomparison : public binary<lexpr,bvptr<B>> {
 	std::string name() const override {
 		return "bvuge";
 	}
+	std::optional<bool> decide(expr::ranges& r) const override {
+		expr::bits a = this->a->range(r);
+		expr::bits b = this->b->range(r);
+		if (!a.tracked())
+			return {};
+		if (a.lo >= b.hi)
+			return true;
+		if (a.hi < b.lo)
+			return false;
+		return {};
+	}
 };
 
 template<std::uint8_t B>
@@ -1453,6 +1749,13 @@ struct expr::bvanding : public bvbinary<B> {
 	std::string name() const override {
 		return "bvand";
 	}
+	expr::bits bounds(expr::ranges& r) const override {
+		expr::bits a = this->a->range(r);
+		expr::bits b = this->b->range(r);
+		if (!a.tracked())
+			return expr::bits::top(B);
+		return expr::bits{B, a.zeros | b.zeros, a.ones & b.ones, 0, std::min(a.hi, b.hi)}.normalize();
+	}
 };
 
 template<std::uint8_t B>
@@ -1461,6 +1764,13 @@ struct expr::bvoring : public bvbinary<B> {
 	std::string name() const override {
 		return "bvor";
 	}
+	expr::bits bounds(expr::ranges& r) const override {
+		expr::bits a = this->a->range(r);
+		expr::bits b = this->b->range(r);
+		if (!a.tracked())
+			return expr::bits::top(B);
+		return expr::bits{B, a.zeros & b.zeros, a.ones | b.ones, std::max(a.lo, b.lo), expr::bits::mask(expr::bits::length(a.hi | b.hi))}.normalize();
+	}
 };
 
 template<std::uint8_t B>
@@ -1469,6 +1779,13 @@ struct expr::bvxoring : public bvbinary<B> {
 	std::string name() const override {
 		return "bvxor";
 	}
+	expr::bits bounds(expr::ranges& r) const override {
+		expr::bits a = this->a->range(r);
+		expr::bits b = this->b->range(r);
+		if (!a.tracked())
+			return expr::bits::top(B);
+		return expr::bits{B, (a.zeros & b.zeros) | (a.ones & b.ones), (a.zeros & b.ones) | (a.ones & b.zeros), 0, expr::bits::mask(expr::bits::length(a.hi | b.hi))}.normalize();
+	}
 };
 
 template<std::uint8_t B>
@@ -1477,6 +1794,24 @@ struct expr::bvshiftl : public bvbinary<B> {
 	std::string name() const override {
 		return "bvshl";
 	}
+	expr::bits bounds(expr::ranges& r) const override {
+		expr::bits a = this->a->range(r);
+		expr::bits b = this->b->range(r);
+		if (!a.tracked())
+			return expr::bits::top(B);
+		std::optional<std::uint64_t> c = b.value();
+		if (!c)
+			return expr::bits::top(B);
+		if (*c >= B)
+			return expr::bits::constant(B, 0);
+		std::uint64_t m = expr::bits::mask(B);
+		expr::bits s{B, ((a.zeros << *c) | expr::bits::mask(*c)) & m, (a.ones << *c) & m, 0, m};
+		if (a.hi <= m >> *c) {
+			s.lo = a.lo << *c;
+			s.hi = a.hi << *c;
+		}
+		return s.normalize();
+	}
 };
 
 template<std::uint8_t B>
@@ -1485,6 +1820,19 @@ struct expr::bvlshiftr : public bvbinary<B> {
 	std::string name() const override {
 		return "bvlshr";
 	}
+	expr::bits bounds(expr::ranges& r) const override {
+		expr::bits a = this->a->range(r);
+		expr::bits b = this->b->range(r);
+		if (!a.tracked())
+			return expr::bits::top(B);
+		std::optional<std::uint64_t> c = b.value();
+		if (!c)
+			return expr::bits::top(B);
+		if (*c >= B)
+			return expr::bits::constant(B, 0);
+		std::uint64_t m = expr::bits::mask(B);
+		return expr::bits{B, (a.zeros >> *c) | (~(m >> *c) & m), a.ones >> *c, a.lo >> *c, a.hi >> *c}.normalize();
+	}
 };
 
 template<std::uint8_t B>
@@ -1493,6 +1841,21 @@ struct expr::bvashiftr : public bvbinary<B> {
 	std::string name() const override {
 		return "bvashr";
 	}
+	expr::bits bounds(expr::ranges& r) const override {
+		expr::bits a = this->a->range(r);
+		expr::bits b = this->b->range(r);
+		if (!a.tracked())
+			return expr::bits::top(B);
+		std::optional<std::uint64_t> c = b.value();
+		if (!c)
+			return expr::bits::top(B);
+		// the sign bit fills the shifted in bits if it is known
+		std::uint64_t i = std::min<std::uint64_t>(*c, B-1);
+		std::uint64_t m = expr::bits::mask(B);
+		std::uint64_t sign = 1LU << ((B-1) % 64);
+		std::uint64_t fill = ~(m >> i) & m;
+		return expr::bits{B, (a.zeros >> i) | (a.zeros & sign ? fill : 0), (a.ones >> i) | (a.ones & sign ? fill : 0), 0, m}.normalize();
+	}
 };
 
 template<std::uint8_t B>
@@ -1504,6 +1867,12 @@ struct expr::bvrotationl : public bvunary<B> {
 	std::string name() const override {
 		return "(_ rotate_left "+std::to_string(this->i)+")";
 	}
+	expr::bits bounds(expr::ranges& r) const override {
+		expr::bits e = this->e->range(r);
+		if (!e.tracked())
+			return e;
+		return expr::bits{B, expr::bits::rotl(e.zeros, this->i, B), expr::bits::rotl(e.ones, this->i, B), 0, expr::bits::mask(B)}.normalize();
+	}
 };
 
 template<std::uint8_t B>
@@ -1515,6 +1884,12 @@ struct expr::bvrotationr : public bvunary<B> {
 	std::string name() const override {
 		return "(_ rotate_right "+std::to_string(this->i)+")";
 	}
+	expr::bits bounds(expr::ranges& r) const override {
+		expr::bits e = this->e->range(r);
+		if (!e.tracked())
+			return e;
+		return expr::bits{B, expr::bits::rotl(e.zeros, B - this->i % B, B), expr::bits::rotl(e.ones, B - this->i % B, B), 0, expr::bits::mask(B)}.normalize();
+	}
 };
 
 template<std::uint8_t B>
@@ -1523,6 +1898,22 @@ struct expr::bvaddition : public bvbinary<B> {
 	std::string name() const override {
 		return "bvadd";
 	}
+	expr::bits bounds(expr::ranges& r) const override {
+		expr::bits a = this->a->range(r);
+		expr::bits b = this->b->range(r);
+		if (!a.tracked())
+			return expr::bits::top(B);
+		std::uint64_t m = expr::bits::mask(B);
+		// the low bits known on both sides determine the low bits of the sum
+		std::uint64_t low = expr::bits::mask(std::min(expr::bits::trailing(a.zeros | a.ones), expr::bits::trailing(b.zeros | b.ones))) & m;
+		std::uint64_t sum = a.ones + b.ones;
+		expr::bits s{B, ~sum & low, sum & low, 0, m};
+		if (a.hi <= m - b.hi) {
+			s.lo = a.lo + b.lo;
+			s.hi = a.hi + b.hi;
+		}
+		return s.normalize();
+	}
 };
 
 template<std::uint8_t B>
@@ -1531,6 +1922,21 @@ struct expr::bvsubstraction : public bvbinary<B> {
 	std::string name() const override {
 		return "bvsub";
 	}
+	expr::bits bounds(expr::ranges& r) const override {
+		expr::bits a = this->a->range(r);
+		expr::bits b = this->b->range(r);
+		if (!a.tracked())
+			return expr::bits::top(B);
+		std::uint64_t m = expr::bits::mask(B);
+		std::uint64_t low = expr::bits::mask(std::min(expr::bits::trailing(a.zeros | a.ones), expr::bits::trailing(b.zeros | b.ones))) & m;
+		std::uint64_t diff = a.ones - b.ones;
+		expr::bits s{B, ~diff & low, diff & low, 0, m};
+		if (a.lo >= b.hi) {
+			s.lo = a.lo - b.hi;
+			s.hi = a.hi - b.lo;
+		}
+		return s.normalize();
+	}
 };
 
 template<std::uint8_t B>
@@ -1555,6 +1961,22 @@ struct expr::bvmultiplication : public bvbinary<B> {
 	std::string name() const override {
 		return "bvmul";
 	}
+	expr::bits bounds(expr::ranges& r) const override {
+		expr::bits a = this->a->range(r);
+		expr::bits b = this->b->range(r);
+		if (!a.tracked())
+			return expr::bits::top(B);
+		std::uint64_t m = expr::bits::mask(B);
+		std::uint64_t low = expr::bits::mask(std::min(expr::bits::trailing(a.zeros | a.ones), expr::bits::trailing(b.zeros | b.ones))) & m;
+		std::uint64_t product = a.ones * b.ones;
+		std::uint64_t zeros = expr::bits::mask(expr::bits::trailing(a.zeros) + expr::bits::trailing(b.zeros)) & m;
+		expr::bits s{B, zeros | (~product & low), product & low, 0, m};
+		if (!b.hi || a.hi <= m / b.hi) {
+			s.lo = a.lo * b.lo;
+			s.hi = a.hi * b.hi;
+		}
+		return s.normalize();
+	}
 };
 
 struct expr::h {
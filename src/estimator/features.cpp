@@ -13,11 +13,20 @@ std::deque<std::reference_wrapper<features>>& features::all() {
 	return all;
 };
 
-features::features(const std::string& name)
-	: name(name) {
+features::features(const std::string& name, std::size_t initial)
+	: name(name),
+	  id(all().size()),
+	  initial(initial) {
 	all().push_back(*this);
 }
 
+std::size_t& features::choice() {
+	thread_local std::vector<std::size_t> choices;
+	while (choices.size() <= this->id)
+		choices.push_back(all()[choices.size()].get().initial);
+	return choices[this->id];
+}
+
 std::string features::values() {
 	std::string str = "";
 
@@ -68,12 +77,10 @@ bool features::parse(const std::string& str) {
 }
 
 features::flag::flag(const std::string& name, bool value)
-	: features(name),
-	  validity(true),
-	  enabled(value) {}
+	: features(name, value ? ENABLED : DISABLED) {}
 
 std::string features::flag::value() {
-	if (enabled) {
+	if (choice() == ENABLED) {
 		return name;
 	} else {
 		return "no-" + name;
@@ -81,7 +88,7 @@ std::string features::flag::value() {
 }
 
 std::string features::flag::example() {
-	if (enabled) {
+	if (choice() == ENABLED) {
 		return "(no-)" + name;
 	} else {
 		return "no-" + name;
@@ -90,22 +97,19 @@ std::string features::flag::example() {
 
 features::flag& features::flag::operator = (const std::string& value) {
 	if (value == "no" || value == "false") {
-		this->validity = true;
-		this->enabled = false;
+		this->choice() = DISABLED;
 	} else if (value == "yes" || value == "true") {
-		this->validity = true;
-		this->enabled = true;
+		this->choice() = ENABLED;
 	} else {
-		this->validity = false;
+		this->choice() = INVALID;
 	}
 	return *this;
 }
 
 bool features::flag::valid() {
-	return this->validity;
+	return this->choice() != INVALID;
 }
 
 features::flag::operator bool () {
-	return this->enabled;
+	return this->choice() == ENABLED;
 }
-
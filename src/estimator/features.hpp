@@ -17,14 +17,19 @@ public:
 	template<class B, class S> static std::shared_ptr<const features::strategy_base<B>> s(std::string name);
 private:
 	std::string name;
+	std::size_t id;
+	std::size_t initial;
 
 	static std::deque<std::reference_wrapper<features>>& all();
+protected:
+	// values are per thread, threads start from the value a feature is defined with
+	std::size_t& choice();
 public:
 	static bool parse(const std::string& str);
 	static std::string values();
 	static std::vector<std::string> examples();
 
-	features(const std::string& name);
+	features(const std::string& name, std::size_t initial);
 	virtual features& operator = (const std::string& value) = 0;
 	virtual bool valid() = 0;
 	virtual std::string value() = 0;
@@ -32,8 +37,11 @@ public:
 };
 
 class features::flag : features {
-	bool validity;
-	bool enabled;
+	enum {
+		DISABLED,
+		ENABLED,
+		INVALID,
+	};
 public:
 	flag(const std::string& name, bool value);
 	features::flag& operator = (const std::string& value) override;
@@ -70,46 +78,45 @@ std::shared_ptr<const features::strategy_base<B>> features::s(std::string name)
 template<class B>
 class features::strategies : features {
 	const std::vector<std::shared_ptr<const features::strategy_base<B>>> options;
-	typename std::vector<std::shared_ptr<const features::strategy_base<B>>>::const_iterator selected;
 public:
 	strategies(const std::string& name, std::initializer_list<std::shared_ptr<const features::strategy_base<B>>> options)
-		: features(name),
-		  options(options),
-		  selected(this->options.begin()) {}
+		: features(name, 0),
+		  options(options) {}
 
 	features::strategies<B>& operator = (const std::string& value) override {
-		for (this->selected = this->options.begin(); this->selected != this->options.end(); this->selected++) {
-			if ((*this->selected)->name == value)
+		std::size_t& selected = this->choice();
+		for (selected = 0; selected != this->options.size(); selected++) {
+			if (this->options[selected]->name == value)
 				return *this;
 		}
 		return *this;
 	}
 
 	bool valid() override {
-		return this->selected != this->options.end();
+		return this->choice() != this->options.size();
 	}
 
 	std::string value() override {
 		std::string str = name + "=";
-		if (this->selected != this->options.end())
-			str += (*this->selected)->name;
+		if (valid())
+			str += this->options[this->choice()]->name;
 		return str;
 	}
 
 	std::string example() override {
 		std::string str = name + "=";
-		if (this->selected != this->options.end())
-			str += (*this->selected)->name;
-		for (auto i = this->options.begin(); i != this->options.end(); i++) {
-			if (i == this->selected)
+		if (valid())
+			str += this->options[this->choice()]->name;
+		for (std::size_t i = 0; i != this->options.size(); i++) {
+			if (i == this->choice())
 				continue;
-			str += "|" + (*i)->name;
+			str += "|" + this->options[i]->name;
 		}
 		return str;
 	}
 
 	B& operator () () {
-		return (*this->selected)->get();
+		return this->options[this->choice()]->get();
 	}
 };
 
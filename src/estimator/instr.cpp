@@ -1,21 +1,97 @@
 #include "estimator/instr.hpp"
 #include "estimator/state.hpp"
-#include "estimator/instr.lex.hpp"
 #include "estimator/instr.tab.hpp"
+#include "estimator/instr.lex.hpp"
 
 #include <memory>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <cstring>
 #include <err.h>
 
-std::shared_ptr<const instr> instr::build_instr(std::string str) {
-	const instr* n = nullptr;
+static constexpr instr::cost_table default_costs = {};
+static thread_local instr::cost_table loaded_costs = default_costs;
+static const std::pair<const char*, unsigned int instr::cost_table::*> cost_names[] = {
+	{"ordinary",          &instr::cost_table::ordinary},
+	{"branch-true-early", &instr::cost_table::branch_true_early},
+	{"branch-true",       &instr::cost_table::branch_true},
+	{"branch-false",      &instr::cost_table::branch_false},
+	{"mem-noswap-min",    &instr::cost_table::mem_noswap_min},
+	{"mem-swap-min",      &instr::cost_table::mem_swap_min},
+	{"mem-32bit-max",     &instr::cost_table::mem_32bit_max},
+	{"mem-40bit-max",     &instr::cost_table::mem_40bit_max},
+};
+
+const instr::cost_table& instr::costs() {
+	return loaded_costs;
+}
+
+// throws std::invalid_argument for a malformed table, as for a malformed instruction
+void instr::load_costs(std::istream& in) {
+	std::string line;
+	while (std::getline(in, line)) {
+		auto hash = line.find('#');
+		if (hash != std::string::npos)
+			line.erase(hash);
+		char key[32];
+		unsigned int value;
+		int n = sscanf(line.c_str(), "%31s %u", key, &value);
+		if (n <= 0)
+			continue;
+		if (n != 2)
+			throw std::invalid_argument("invalid cost table line: " + line);
+		auto c = std::find_if(std::begin(cost_names), std::end(cost_names), [&key](const auto& c) {
+			return !strcmp(c.first, key);
+		});
+		if (c == std::end(cost_names))
+			throw std::invalid_argument("unknown cost: " + std::string(key));
+		loaded_costs.*c->second = value;
+	}
+	if (in.bad())
+		throw std::invalid_argument("reading cost table");
+}
+
+void instr::reset_costs() {
+	loaded_costs = default_costs;
+}
+
+void instr::set_costs(const cost_table& costs) {
+	loaded_costs = costs;
+}
+
+std::string instr::cost_table::str() const {
+	std::string str = "";
+	for (const auto& c: cost_names)
+		str += std::string(c.first) + "=" + std::to_string(this->*c.second) + ",";
+	str.erase(str.end()-1);
+	return str;
+}
+
+std::shared_ptr<const instr> instr::build_instr(std::string_view str) {
+	thread_local struct instr_scanner {
+		yyscan_t scanner;
+		std::string_view in;
+		instr_scanner() {
+			if (instrlex_init_extra(&this->in, &this->scanner))
+				errx(-1, "instr_lex_init");
+		}
+		~instr_scanner() {
+			instrlex_destroy(this->scanner);
+		}
+	} s;
+	instr* n = nullptr;
 
-	YY_BUFFER_STATE buf = instr_scan_string(str.c_str());
-	if(instr_parse(&n, str))
-		errx(-1, "PARSER error: cannot accept string: %s\n", str.c_str());
-	instr_delete_buffer(buf);
+	s.in = str;
+	instrrestart(nullptr, s.scanner);
+	if(instr_parse(s.scanner, &n, str))
+		throw std::invalid_argument("PARSER error: cannot accept string: " + std::string(str));
+	n->tabulate();
 
 	return std::shared_ptr<const instr>(n);
 }
@@ -40,6 +116,35 @@ std::uint32_t instr::get_id() const
 	return this->id;
 }
 
+// must run once after construction, the cost table is read before parsing the listing
+void instr::tabulate() {
+	cost& c = this->tabulated;
+	c.type = this->type();
+	c.writescc = this->writescc();
+	switch (c.type) {
+	case instr::BRANCH:
+		// TODO: handle defer
+		c.min = c.max = instr::costs().branch_false;
+		c.taken = instr::costs().branch_true;
+		c.taken_early = instr::costs().branch_true_early;
+		return;
+	case instr::FIN:
+		c.min = c.max = 0;
+		break;
+	case instr::MEM:
+		c.min = this->cycles();
+		c.max = this->waits() ? std::max(c.min, this->max_cycles()) : c.min;
+		break;
+	default:
+		c.min = c.max = this->cycles();
+	}
+	c.taken = c.taken_early = c.min;
+}
+
+const instr::cost& instr::get_cost() const {
+	return this->tabulated;
+}
+
 std::string instr::str() const {
 	std::string s = "." + std::to_string(this->id);
 	while (s.length() < 6)
@@ -47,6 +152,11 @@ std::string instr::str() const {
 	return s + "  " + name();
 }
 
+// the instruction without its address, which changes whenever code before it does
+std::string instr::content() const {
+	return name() + str().substr(instr::str().length());
+}
+
 unsigned int instr::cycles() const {
 	errx(-1, "no %s fixed cycles known", name().c_str());
 	return 0;
@@ -264,7 +374,7 @@ bool instr::ordinary::waits() const {
 }
 
 unsigned int instr::ordinary::cycles() const {
-	return instr::ordinary::COST;
+	return instr::costs().ordinary;
 }
 
 double instr::ordinary::dram_cycles() const {
@@ -281,6 +391,11 @@ std::string instr::branch::str() const {
 	(this->defer ? (", defer[" + std::to_string(this->defer) + "]") : "");
 }
 
+// the target is part of the structure of the cfg
+std::string instr::branch::content() const {
+	return name() + (this->defer ? (", defer[" + std::to_string(this->defer) + "]") : "");
+}
+
 bool instr::branch::waits() const {
 	return false;
 }
@@ -454,7 +569,9 @@ expr::bvptr<33> instr::shift_cntl::rightindirect::calculate(expr::bvptr<33> e, c
 }
 
 std::shared_ptr<const instr::fin> instr::fin::build() {
-	return std::make_shared<const instr::fin>();
+	auto f = std::make_shared<instr::fin>();
+	f->tabulate();
+	return f;
 }
 
 instr::fin::fin()
@@ -480,6 +597,71 @@ double instr::fin::dram_cycles() const {
 	return 0.0;
 }
 
+std::shared_ptr<const instr::summary> instr::summary::build(std::uint32_t header, std::vector<std::shared_ptr<const instr>> body, std::size_t iterations, unsigned int iteration_cycles, double iteration_dram_cycles) {
+	auto s = std::make_shared<instr::summary>(header, body, iterations, iteration_cycles, iteration_dram_cycles);
+	s->tabulate();
+	return s;
+}
+
+instr::summary::summary(std::uint32_t header, std::vector<std::shared_ptr<const instr>> body, std::size_t iterations, unsigned int iteration_cycles, double iteration_dram_cycles)
+	: instr(ID + header),
+	  body(body),
+	  iterations(iterations),
+	  iteration_cycles(iteration_cycles),
+	  iteration_dram_cycles(iteration_dram_cycles) {}
+
+std::string instr::summary::name() const {
+	return "loop_summary";
+}
+
+std::string instr::summary::str() const {
+	return instr::str() + " " + name() + "[" + std::to_string(get_id() - ID) + ", "
+		+ std::to_string(this->iterations) + "x" + std::to_string(this->iteration_cycles) + "]";
+}
+
+std::string instr::summary::content() const {
+	std::string s = name() + "[" + std::to_string(this->iterations) + "x" + std::to_string(this->iteration_cycles) + "]";
+	for (auto& n: this->body)
+		s += "; " + n->content();
+	return s;
+}
+
+// the last memory access and cc write may happen anywhere in the summarized iterations
+enum instr::type instr::summary::type() const {
+	return instr::MEM;
+}
+
+bool instr::summary::waits() const {
+	return false;
+}
+
+unsigned int instr::summary::cycles() const {
+	return this->iterations * this->iteration_cycles;
+}
+
+double instr::summary::dram_cycles() const {
+	return this->iterations * this->iteration_dram_cycles;
+}
+
+bool instr::summary::writescc() const {
+	return true;
+}
+
+/* Everything written in the loop body is unknown after an unknown number of
+ * iterations. A single pass against the entry state covers all iterations:
+ * the registers and flags an instruction writes are fixed by the
+ * instruction, and any memory write, wherever it goes, becomes an
+ * invalidation of all memory, so later iterations write nothing more. */
+state::updates instr::summary::perform(const state::exec& state) const {
+	static const std::string reason = "loop_summary";
+	state::updates r;
+	for (auto& n: this->body) {
+		for (auto& u: n->perform(state))
+			r.push_back(state::undef(u, reason));
+	}
+	return r;
+}
+
 std::string instr::alu_op::plus::str() const {
 	return "+";
 }
@@ -997,7 +1179,7 @@ enum instr::type instr::br::type() const {
 
 unsigned int instr::br::cycles() const {
 	// TODO: check these costs, documentation sounds more like 2 cycles
-	return instr::br::COST_TRUE;
+	return instr::costs().branch_true;
 }
 
 instr::dbl_shf::dbl_shf(std::uint32_t id, const instr::dst* dst, const instr::src* srcA, const instr::src* srcB, const instr::shift_cntl* sc, bool gpr_wrboth)
@@ -1283,9 +1465,9 @@ template <class O, class X>
 unsigned int instr::mem<O,X>::cycles() const {
 	unsigned int cycles = 0;
 	if (this->ctx_swap == (std::uint32_t) -1U) {
-		cycles += instr::mem<O,X>::COST_NOSWAP_MIN;
+		cycles += instr::costs().mem_noswap_min;
 	} else {
-		cycles += instr::mem<O,X>::COST_SWAP_MIN;
+		cycles += instr::costs().mem_swap_min;
 	}
 	cycles += std::max(this->src1->cycles(), this->src2->cycles());
 	return cycles;
@@ -1294,9 +1476,9 @@ unsigned int instr::mem<O,X>::cycles() const {
 template <class O, class X>
 unsigned int instr::mem<O,X>::max_cycles() const {
 	if (!this->sc1 && !this->sc2) {
-		return instr::mem<O,X>::COST_32BIT_MAX;
+		return instr::costs().mem_32bit_max;
 	} else {
-		return instr::mem<O,X>::COST_40BIT_MAX;
+		return instr::costs().mem_40bit_max;
 	}
 }
 
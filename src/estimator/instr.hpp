@@ -4,12 +4,14 @@
 #include "estimator/state.hpp"
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
+#include <istream>
 
 class instr {
 public:
-	static std::shared_ptr<const instr> build_instr(std::string str);
+	static std::shared_ptr<const instr> build_instr(std::string_view str);
 
 	enum type{
 		RTN,
@@ -22,6 +24,22 @@ public:
 		OTHER   /*general sequential instruction*/
 	};
 
+	struct cost_table;
+	/* per instruction costs, looked up by state::perf instead of walking the operands */
+	struct cost {
+		enum instr::type type;
+		bool writescc;
+		unsigned int min;         // cycles without waiting, branch not taken
+		unsigned int max;         // cycles when waiting for the previous memory access
+		unsigned int taken;       // branch taken, cc written by the previous instruction
+		unsigned int taken_early; // branch taken, cc written earlier
+	};
+
+	static const cost_table& costs();
+	static void load_costs(std::istream& in);
+	static void reset_costs();
+	static void set_costs(const cost_table& costs);
+
 	class src;
 	class dst;
 
@@ -51,6 +69,7 @@ public:
 	class ld_field_like;
 
 	class fin;
+	class summary;
 	class alu;
 	class alu_shf;
 	class asr;
@@ -94,13 +113,19 @@ public:
 
 private:
 	const std::uint32_t id;
+	cost tabulated;
+
+protected:
+	void tabulate();
 
 public:
 	instr(std::uint32_t id);
 	virtual ~instr() = default;
 	std::uint32_t get_id() const;
+	const cost& get_cost() const;
 	virtual std::string name() const = 0;
 	virtual std::string str() const;
+	virtual std::string content() const;
 	virtual type type() const = 0;
 	virtual bool waits() const = 0;
 	virtual unsigned int cycles() const;
@@ -111,6 +136,19 @@ public:
 	virtual expr::lptr check(const state::exec& state) const;
 };
 
+struct instr::cost_table {
+	unsigned int ordinary = 1;
+	unsigned int branch_true_early = 3;
+	unsigned int branch_true = 4;
+	unsigned int branch_false = 1;
+	unsigned int mem_noswap_min = 1;
+	unsigned int mem_swap_min = 3;
+	unsigned int mem_32bit_max = 16;
+	unsigned int mem_40bit_max = 25;
+
+	std::string str() const;
+};
+
 class instr::dst {
 public:
 	virtual ~dst() = default;
@@ -234,7 +272,6 @@ public:
 class instr::ordinary : public instr {
 public:
 	using instr::instr;
-	static const unsigned int COST = 1;
 	enum instr::type type() const override;
 	bool waits() const override;
 	unsigned int cycles() const override;
@@ -348,16 +385,13 @@ public:
 };
 
 class instr::branch : public instr {
-public:
-	static const unsigned int COST_TRUE_EARLY  = 3;
-	static const unsigned int COST_TRUE  = 4;
-	static const unsigned int COST_FALSE = 1;
 protected:
 	const std::uint32_t target;
 	const std::uint32_t defer;
 public:
 	branch(std::uint32_t id, std::uint32_t target, std::uint32_t defer);
 	std::string str() const override;
+	std::string content() const override;
 	bool waits() const override;
 	bool writescc() const override;
 	double dram_cycles() const override;
@@ -384,6 +418,31 @@ public:
 	double dram_cycles() const override;
 };
 
+/* stands for the iterations of a loop which are not enumerated, see cfg::summarize_loops */
+class instr::summary : public instr {
+private:
+	const std::vector<std::shared_ptr<const instr>> body;
+	const std::size_t iterations;
+	const unsigned int iteration_cycles;
+	const double iteration_dram_cycles;
+public:
+	static std::shared_ptr<const instr::summary> build(std::uint32_t header, std::vector<std::shared_ptr<const instr>> body, std::size_t iterations, unsigned int iteration_cycles, double iteration_dram_cycles);
+
+	// summaries are numbered after fin by the address of their loop header
+	static const std::uint32_t ID = instr::fin::ID + 1;
+
+	summary(std::uint32_t header, std::vector<std::shared_ptr<const instr>> body, std::size_t iterations, unsigned int iteration_cycles, double iteration_dram_cycles);
+	std::string name() const override;
+	std::string str() const override;
+	std::string content() const override;
+	enum instr::type type() const override;
+	bool waits() const override;
+	unsigned int cycles() const override;
+	double dram_cycles() const override;
+	bool writescc() const override;
+	state::updates perform(const state::exec& state) const override;
+};
+
 class instr::alu_op {
 public:
 	class plus;
@@ -717,11 +776,6 @@ public:
 
 template <class O, class X>
 class instr::mem : public instr {
-public:
-	static const unsigned int COST_NOSWAP_MIN  = 1;
-	static const unsigned int COST_SWAP_MIN  = 3;
-	static const unsigned int COST_32BIT_MAX  = 16;
-	static const unsigned int COST_40BIT_MAX  = 25;
 protected:
 	const O* op;
 	const std::vector<const X*> xfers;
@@ -9,6 +9,7 @@
 #include <optional>
 #include <unordered_set>
 #include <string>
+#include <vector>
 #include <mutex>
 #include <cstdint>
 #include <iostream>
@@ -59,11 +60,20 @@ std::string sat_checker::z3_version() {
 	return buf;
 }
 
+// of the running z3 processes, and of the exited ones up to their exit
+static stats::cputime& z3_cputime() {
+	static stats::cputime cputime("z3.cputime");
+	return cputime;
+}
+
+static stats::maxmem& z3_maxmem() {
+	static stats::maxmem maxmem("z3.maxmem");
+	return maxmem;
+}
+
 sat_checker::sat_checker()
 	: in(nullptr),
 	  out(nullptr) {
-	static stats::cputime cputime("z3.cputime");
-	static stats::maxmem maxmem("z3.maxmem");
 
 	int in[2];
 	int out[2];
@@ -100,8 +110,8 @@ sat_checker::sat_checker()
 	if (close(in[0]) ||
 	    close(out[1]))
 		err(-1, "close()");
-	cputime.add(this->pid);
-	maxmem.add(this->pid);
+	z3_cputime().add(this->pid);
+	z3_maxmem().add(this->pid);
 	m.unlock();
 
 	this->fbi = new __gnu_cxx::stdio_filebuf<char>(in[1], std::ios_base::out);
@@ -115,6 +125,9 @@ sat_checker::sat_checker()
 sat_checker::~sat_checker() {
 	int wstatus;
 
+	// while z3 still runs, an exited process has no memory stats
+	z3_cputime().remove(this->pid);
+	z3_maxmem().remove(this->pid);
 	this->in.rdbuf(nullptr);
 	delete this->fbi;
 	if (waitpid(this->pid, &wstatus, 0) == -1)
@@ -246,6 +259,65 @@ sat_checker::model sat_checker::get_model() {
 	return m;
 }
 
+static std::size_t skip_balanced(const std::string& str, std::size_t p) {
+	std::ptrdiff_t braces = 0;
+	for (; p < str.size(); p++) {
+		if (str[p] == '(')
+			braces += 1;
+		if (str[p] == ')')
+			braces -= 1;
+		if (braces == 0 && (str[p] == ')' || str[p+1] == ' ' || str[p+1] == ')'))
+			return p+1;
+	}
+	return p;
+}
+
+/* only fetches the given variables with a single (get-value ...), leaving the
+ * model incomplete, most satisfiable checks never look at anything else */
+sat_checker::model sat_checker::get_model(const std::vector<std::string>& names) {
+	model m;
+	m.complete = false;
+	if (names.empty())
+		return m;
+
+	this->in << "(get-value (";
+	for (auto& n: names)
+		this->in << " " << n;
+	this->in << "))" << std::endl;
+	this->in.flush();
+	std::string z3_out = read_balanced();
+	if (z3_out.find("(error ") != std::string::npos)
+		errx(-1, "z3 get-value: %s", z3_out.c_str());
+
+	std::size_t p = z3_out.find('(');
+	for (auto& n: names) {
+		p = z3_out.find('(', p+1);
+		if (p == std::string::npos)
+			errx(-1, "z3 get-value: %s", z3_out.c_str());
+		p = z3_out.find_first_not_of(" \t", skip_balanced(z3_out, p+1));
+		if (p == std::string::npos)
+			errx(-1, "z3 get-value: %s", z3_out.c_str());
+		if (!z3_out.compare(p, 2, "#x")) {
+			m.variables[n] = std::stoull(z3_out.substr(p+2), nullptr, 16);
+		} else if (!z3_out.compare(p, 2, "#b")) {
+			m.variables[n] = std::stoull(z3_out.substr(p+2), nullptr, 2);
+		} else if (!z3_out.compare(p, 5, "(_ bv")) {
+			m.variables[n] = std::stoull(z3_out.substr(p+5), nullptr, 10);
+		}
+		p = z3_out.find(')', skip_balanced(z3_out, p));
+	}
+
+	return m;
+}
+
+bool sat_checker::model::is_complete() const {
+	return this->complete;
+}
+
+bool sat_checker::model::includes(const std::string n) const {
+	return this->complete || this->variables.find(n) != this->variables.end();
+}
+
 std::optional<std::uint64_t> sat_checker::model::get_value(const std::string n) const {
 	auto i = this->variables.find(n);
 	if (i == this->variables.end())
@@ -304,3 +376,7 @@ bool sat_checker::unsat_core::includes(std::string id) const {
 	return this->set.find(id) != this->set.end();
 }
 
+std::size_t sat_checker::unsat_core::size() const {
+	return this->set.size();
+}
+
@@ -4,6 +4,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 #include <unordered_set>
 #include <iostream>
 #include <optional>
@@ -32,7 +33,10 @@ public:
 	private:
 		std::map<std::string,std::uint64_t> variables = {};
 		std::map<std::pair<std::string,std::uint64_t>,std::uint64_t> arrays = {};
+		bool complete = true;
 	public:
+		bool is_complete() const;
+		bool includes(const std::string n) const;
 		std::optional<std::uint64_t> get_value(const std::string n) const;
 		std::optional<std::uint64_t> get_value(std::string n, std::uint64_t o) const;
 		std::map<std::uint64_t,std::uint64_t> get_values(std::string n) const;
@@ -46,6 +50,7 @@ public:
 		unsat_core(std::unordered_set<std::string>&& set);
 		unsat_core(std::initializer_list<std::string> l);
 		bool includes(std::string id) const;
+		std::size_t size() const;
 	};
 	static std::string z3_version();
 private:
@@ -70,6 +75,7 @@ public:
 	void assert_named(const assumption& a, const class expr::defs& d);
 	bool check_sat();
 	model get_model();
+	model get_model(const std::vector<std::string>& names);
 	unsat_core get_unsat_core();
 };
 
@@ -0,0 +1,78 @@
+#include "estimator/spill.hpp"
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+
+#include <err.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+
+const std::size_t spill::CHUNK = 64 << 20;
+
+spill::~spill() {
+	for (auto& c: this->chunks) {
+		if (c.base)
+			munmap(c.base, CHUNK);
+	}
+	if (this->fd != -1)
+		close(this->fd);
+}
+
+void spill::grow() {
+	if (this->fd == -1) {
+		const char* dir = std::getenv("TMPDIR");
+		std::string path = std::string(dir ? dir : "/tmp") + "/nfp-estimator.XXXXXX";
+		this->fd = mkstemp(path.data());
+		if (this->fd == -1)
+			err(-1, "mkstemp(%s)", path.c_str());
+		unlink(path.c_str());
+	}
+
+	off_t size = (this->chunks.size() + 1) * CHUNK;
+	if (ftruncate(this->fd, size) == -1)
+		err(-1, "ftruncate()");
+	void* base = mmap(nullptr, CHUNK, PROT_READ | PROT_WRITE, MAP_SHARED, this->fd, size - CHUNK);
+	if (base == MAP_FAILED)
+		err(-1, "mmap()");
+	this->chunks.push_back({(char*) base, 0});
+	this->used = 0;
+}
+
+spill::handle spill::put(const std::string& data) {
+	if (data.size() > CHUNK)
+		errx(-1, "spilled record of %zu bytes exceeds chunk", data.size());
+
+	std::lock_guard guard(this->mutex);
+	if (this->chunks.empty() || CHUNK - this->used < data.size())
+		grow();
+	handle h = {this->chunks.size()-1, this->used, data.size()};
+	chunk& c = this->chunks.back();
+	std::memcpy(c.base + h.offset, data.data(), h.length);
+	c.live += h.length;
+	this->used += h.length;
+	return h;
+}
+
+std::string spill::get(const handle& h) const {
+	std::lock_guard guard(this->mutex);
+	return std::string(this->chunks[h.chunk].base + h.offset, h.length);
+}
+
+void spill::release(const handle& h) {
+	std::lock_guard guard(this->mutex);
+	chunk& c = this->chunks[h.chunk];
+	c.live -= h.length;
+	if (c.live || h.chunk == this->chunks.size()-1)
+		return;
+
+	// the file keeps its size, only the blocks of the chunk are freed
+	munmap(c.base, CHUNK);
+	c.base = nullptr;
+	if (fallocate(this->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, h.chunk * CHUNK, CHUNK) == -1)
+		err(-1, "fallocate()");
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/* Append-only storage for records evicted from memory. The records live in
+ * an unlinked temporary file mapped in chunks, so the kernel can write them
+ * back instead of keeping them in anonymous memory. A chunk is returned to
+ * the file system once all of its records have been released. */
+class spill {
+public:
+	static const std::size_t CHUNK;
+
+	struct handle {
+		std::size_t chunk;
+		std::size_t offset;
+		std::size_t length;
+	};
+private:
+	struct chunk {
+		char* base = nullptr;
+		std::size_t live = 0;
+	};
+
+	mutable std::mutex mutex;
+	int fd = -1;
+	std::vector<chunk> chunks = {};
+	std::size_t used = 0;
+
+	void grow();
+public:
+	spill() = default;
+	spill(const spill&) = delete;
+	~spill();
+	handle put(const std::string& data);
+	std::string get(const handle& h) const;
+	void release(const handle& h);
+};
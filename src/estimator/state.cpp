@@ -8,6 +8,10 @@
 
 #include <vector>
 #include <set>
+#include <deque>
+#include <unordered_set>
+#include <mutex>
+#include <algorithm>
 #include <utility>
 #include <memory>
 #include <limits>
@@ -18,6 +22,8 @@
 bool state::debug_assignments = false;
 std::set<std::uint32_t> state::debug_instrs = {};
 
+auto o_learned_unsat_cores = features::flag("learned-unsat-cores", true);
+
 auto o_sat_strategy = features::strategies<state::sat_strategy>("sat-strategy", {
 	features::s<state::sat_strategy, state::sat_strategy::unsat_core>("unsat-core"),
 	features::s<state::sat_strategy, state::sat_strategy::incremental>("incremental"),
@@ -52,11 +58,12 @@ state::perf::info::info(unsigned int sincecc, unsigned int sincemem)
 	  sincemem(sincemem) {}
 
 state::perf::info state::perf::info::apply(const instr& n, bool branchtrue) const {
-	unsigned int c = cycles(n, *this, branchtrue);
-	info r = info(this->sincecc + c, this->sincemem + c);
-	if (n.writescc())
+	const instr::cost& c = n.get_cost();
+	unsigned int cycles = perf::cycles(n, *this, branchtrue);
+	info r = info(this->sincecc + cycles, this->sincemem + cycles);
+	if (c.writescc)
 		r.sincecc = 0;
-	if (n.type() == instr::MEM)
+	if (c.type == instr::MEM)
 		r.sincemem = 0;
 	return r;
 }
@@ -69,33 +76,13 @@ state::perf::info state::perf::info::merge(const info& i) const {
 }
 
 unsigned int state::perf::cycles(const instr& n, const info& i, bool branchtrue) {
-	switch (n.type()) {
-	case instr::BRANCH:
-		// TODO: handle defer
-		if (branchtrue) {
-			if (i.sincecc > 0) {
-				return instr::branch::COST_TRUE_EARLY;
-			} else {
-				return instr::branch::COST_TRUE;
-			}
-		} else {
-			return instr::branch::COST_FALSE;
-		}
-	case instr::MEM: {
-		unsigned int min = n.cycles();
-		if (!n.waits())
-			return min;
-		unsigned int max = n.max_cycles();
-		if (i.sincemem >= max-min) {
-			return min;
-		} else {
-			return max-i.sincemem;
-		}}
-	case instr::FIN:
-		return 0;
-	default:
-		return n.cycles();
-	}
+	const instr::cost& c = n.get_cost();
+	if (branchtrue && c.type == instr::BRANCH)
+		return i.sincecc > 0 ? c.taken_early : c.taken;
+	// max equals min unless the instruction waits for memory
+	if (i.sincemem >= c.max-c.min)
+		return c.min;
+	return c.max-i.sincemem;
 }
 
 void state::perf::apply(const instr& n, const info& i, std::size_t loopdepth, bool branchtrue) {
@@ -157,9 +144,32 @@ void state::exec::assume(const sat_checker::assumption& a) {
 		}
 	}
 
+	// decided by the abstract values, e.g. of registers merged statically
+	expr::ranges r = abstraction();
+	std::optional<bool> d = a.e->decide(r);
+	if (d) {
+		static stats::counter s_decided("state.abstract-decided");
+		s_decided.count();
+		if (!*d) {
+			this->sat = false;
+			this->model = sat_checker::model();
+			this->unsat_core = sat_checker::unsat_core({a.id});
+		}
+		return;
+	}
+
 	this->assumptions.push_back(a);
 }
 
+// the packet size lies within its bounds, as also asserted for the solver
+expr::ranges state::exec::abstraction() const {
+	expr::ranges r;
+	std::uint64_t hi = std::min<std::uint64_t>(this->max_value, expr::bits::mask(14));
+	if (this->minimize && this->min_value <= hi)
+		r.bind(this->minimize->declname, expr::bits{14, 0, 0, this->min_value, hi}.normalize());
+	return r;
+}
+
 std::string state::exec::assumption_name(const instr& n, std::size_t loopdepth, bool branchtrue) {
 	return n.name()+(branchtrue ? "T" : "F" )+std::to_string(n.get_id())+"L"+std::to_string(loopdepth);
 }
@@ -176,9 +186,9 @@ void state::exec::apply(const instr& n, const perf::info& i, std::size_t loopdep
 	this->sumdramcycles += n.dram_cycles();
 	this->sumcycles     += perf::cycles(n, d, branchtrue);
 
-	if (n.type() == instr::MEM)
+	if (n.get_cost().type == instr::MEM)
 		this->lastmem = this->sumcycles;
-	if (n.writescc())
+	if (n.get_cost().writescc)
 		this->lastcc = this->sumcycles;
 
 	if (this->sat && !*this->sat)
@@ -214,7 +224,9 @@ void state::exec::apply(const instr& n, const perf::info& i, std::size_t loopdep
 		u->store(*this);
 }
 
-state::exec state::exec::static_merge(const state::exec& o) const {
+state::exec state::exec::static_merge(const state::exec& o, bool widen) const {
+	expr::ranges mine = abstraction();
+	expr::ranges theirs = o.abstraction();
 	state::exec n;
 	n.summaxcycles = std::max(this->summaxcycles, o.summaxcycles);
 	n.sumdramcycles = std::max(this->sumdramcycles, o.sumdramcycles);
@@ -222,31 +234,35 @@ state::exec state::exec::static_merge(const state::exec& o) const {
 	n.lastmem = std::max(this->lastmem, o.lastmem);
 	n.lastcc = std::max(this->lastcc, o.lastcc);
 
-	for (auto& a: this->assumptions) {
-		for (auto& b: o.assumptions) {
-			if (a == b)
-				n.assumptions.push_back(a);
+	std::size_t prefix = 0;
+	while (prefix < this->assumptions.size() && prefix < o.assumptions.size() && this->assumptions[prefix].e == o.assumptions[prefix].e)
+		prefix++;
+	n.assumptions.assign(this->assumptions.begin(), this->assumptions.begin() + prefix);
+	for (auto a = this->assumptions.begin() + prefix; a != this->assumptions.end(); a++) {
+		for (auto b = o.assumptions.begin() + prefix; b != o.assumptions.end(); b++) {
+			if (*a == *b)
+				n.assumptions.push_back(*a);
 		}
 	}
-	for (auto& [r,e]: this->registers) {
+	for (auto& [r,e]: this->registers.flatten()) {
 		auto f = o.registers.find(r);
-		if (f != o.registers.end())
-			n.registers[r] = e->static_merge(f->second);
+		if (f)
+			n.registers[r] = e->static_merge(*f, mine, theirs, widen);
 	}
-	for (auto& [r,e]: this->flags) {
+	for (auto& [r,e]: this->flags.flatten()) {
 		auto f = o.flags.find(r);
-		if (f != o.flags.end())
-			n.flags[r] = e->static_merge(f->second);
+		if (f)
+			n.flags[r] = e->static_merge(*f, mine, theirs, widen);
 	}
-	for (auto& [r,e]: this->mem8) {
+	for (auto& [r,e]: this->mem8.flatten()) {
 		auto f = o.mem8.find(r);
-		if (f != o.mem8.end())
-			n.mem8[r] = e->static_merge(f->second);
+		if (f)
+			n.mem8[r] = e->static_merge(*f, mine, theirs, widen);
 	}
-	for (auto& [r,e]: this->mem32) {
+	for (auto& [r,e]: this->mem32.flatten()) {
 		auto f = o.mem32.find(r);
-		if (f != o.mem32.end())
-			n.mem32[r] = e->static_merge(f->second);
+		if (f)
+			n.mem32[r] = e->static_merge(*f, mine, theirs, widen);
 	}
 	for (auto& d: this->defered)
 		d.second->to_undef("no_defered_merge")->store(n);
@@ -259,10 +275,114 @@ state::exec state::exec::static_merge(const state::exec& o) const {
 		n.minimize = this->minimize;
 	n.min_value = std::min(this->min_value, o.min_value);
 	n.max_value = std::max(this->max_value, o.max_value);
+	// both bounds already reflect their assumptions, the joined interval
+	// cannot be tightened by solving for the common assumptions only
+	if (this->minimized == this->assumptions.size() && o.minimized == o.assumptions.size())
+		n.minimized = n.assumptions.size();
+
+	return n;
+}
+
+/* Joins two feasible paths reaching the same edge. They share a prefix of
+ * assumptions and diverge on a branch, so the conjunction of the remaining
+ * assumptions of this path selects its values. Gives up when the diverging
+ * assumptions and ifthenelse terms exceed the budget or pending updates
+ * would have to be dropped. */
+std::optional<state::exec> state::exec::path_merge(const state::exec& o, std::size_t budget) const {
+	if (!this->defered.empty() || !o.defered.empty())
+		return {};
+	if (this->is_unsat() || o.is_unsat() || this->minimize != o.minimize)
+		return {};
+
+	std::size_t prefix = 0;
+	while (prefix < this->assumptions.size() && prefix < o.assumptions.size() && this->assumptions[prefix] == o.assumptions[prefix])
+		prefix++;
+	if (prefix == this->assumptions.size() || prefix == o.assumptions.size())
+		return {};
+	std::size_t cost = this->assumptions.size() + o.assumptions.size() - 2*prefix;
+	if (cost > budget)
+		return {};
+
+	expr::lptr a = this->assumptions[prefix].e;
+	for (auto i = this->assumptions.begin() + prefix + 1; i != this->assumptions.end(); i++)
+		a = expr::land(a, i->e);
+	expr::lptr b = o.assumptions[prefix].e;
+	for (auto i = o.assumptions.begin() + prefix + 1; i != o.assumptions.end(); i++)
+		b = expr::land(b, i->e);
+
+	state::exec n;
+	n.summaxcycles = std::max(this->summaxcycles, o.summaxcycles);
+	n.sumdramcycles = std::max(this->sumdramcycles, o.sumdramcycles);
+	n.sumcycles = std::max(this->sumcycles, o.sumcycles);
+	n.lastmem = std::max(this->lastmem, o.lastmem);
+	n.lastcc = std::max(this->lastcc, o.lastcc);
+	n.assumptions.assign(this->assumptions.begin(), this->assumptions.begin() + prefix);
+	n.assumptions.push_back(sat_checker::assumption(expr::lor(a, b), "merge" + std::to_string(prefix)));
+
+	// locations known on one path only are left undefined
+	for (auto& [r,e]: this->registers.flatten()) {
+		auto f = o.registers.find(r);
+		if (!f)
+			continue;
+		if (*e == **f) {
+			n.registers[r] = e;
+		} else {
+			n.registers[r] = expr::ite(a, e, *f);
+			cost++;
+		}
+	}
+	for (auto& [r,e]: this->flags.flatten()) {
+		auto f = o.flags.find(r);
+		if (!f)
+			continue;
+		if (*e == **f) {
+			n.flags[r] = e;
+		} else {
+			n.flags[r] = expr::ite(a, e, *f);
+			cost++;
+		}
+	}
+	for (auto& [r,e]: this->mem8.flatten()) {
+		auto f = o.mem8.find(r);
+		if (!f)
+			continue;
+		if (*e == **f) {
+			n.mem8[r] = e;
+		} else {
+			n.mem8[r] = expr::ite(a, e, *f);
+			cost++;
+		}
+	}
+	for (auto& [r,e]: this->mem32.flatten()) {
+		auto f = o.mem32.find(r);
+		if (!f)
+			continue;
+		if (*e == **f) {
+			n.mem32[r] = e;
+		} else {
+			n.mem32[r] = expr::ite(a, e, *f);
+			cost++;
+		}
+	}
+	if (cost > budget)
+		return {};
+
+	n.minimize = this->minimize;
+	n.min_value = std::min(this->min_value, o.min_value);
+	n.max_value = std::max(this->max_value, o.max_value);
+	if (this->minimized == this->assumptions.size() && o.minimized == o.assumptions.size())
+		n.minimized = n.assumptions.size();
 
 	return n;
 }
 
+void state::exec::freeze() {
+	this->registers.freeze();
+	this->flags.freeze();
+	this->mem8.freeze();
+	this->mem32.freeze();
+}
+
 unsigned int state::exec::cycles() const {
 	return this->sumcycles;
 }
@@ -299,8 +419,8 @@ void state::update::mem<32>::store(state::exec& state) const {
 void state::update::invalidate_mem::store(state::exec& state) const {
 	if (debug_assignments || this->is_debugged)
 		std::cerr << "invalidate memory" << std::endl;
-	state.mem8 = {};
-	state.mem32 = {};
+	state.mem8.clear();
+	state.mem32.clear();
 }
 
 void state::update::defered::store(state::exec& state) const {
@@ -310,30 +430,30 @@ void state::update::defered::store(state::exec& state) const {
 expr::bvptr<32> state::exec::operator[](const state::deposit::reg& d) const {
 	std::string loc = d.location();
 	auto i = this->registers.find(loc);
-	if (i != this->registers.end())
-		return i->second;
+	if (i)
+		return *i;
 	return expr::undef<32>(loc);
 }
 
 expr::bvptr<1> state::exec::operator[](const state::deposit::flag& d) const {
 	std::string loc = d.location();
 	auto i = this->flags.find(loc);
-	if (i != this->flags.end())
-		return i->second;
+	if (i)
+		return *i;
 	return expr::undef<1>(loc);
 }
 
 expr::aptr<32,8> state::exec::operator[](expr::avptr<32,8> a) const {
 	auto i = this->mem8.find(a->declname);
-	if (i != this->mem8.end())
-		return i->second;
+	if (i)
+		return *i;
 	return expr::undef_array<32,8>("unknown_mem8", a);
 }
 
 expr::aptr<32,32> state::exec::operator[](expr::avptr<32,32> a) const {
 	auto i = this->mem32.find(a->declname);
-	if (i != this->mem32.end())
-		return i->second;
+	if (i)
+		return *i;
 	return expr::undef_array<32,32>("unknown_mem32", a);
 }
 
@@ -345,6 +465,53 @@ bool state::exec::is_unsat() const {
 	return this->sat && !*this->sat;
 }
 
+/* Unsat cores found by the solver. Assumptions are compared structurally and
+ * undefined values only equal themselves, so any later path assuming all
+ * assumptions of a core is unsat as well. Cores which include the bounds of
+ * the minimized value are not kept. */
+class learned_cores {
+	static constexpr std::size_t MAX_CORES = 256;
+	static constexpr std::size_t MAX_CORE_SIZE = 4;
+
+	std::mutex mutex;
+	std::deque<std::vector<sat_checker::assumption>> cores;
+public:
+	void learn(const std::vector<sat_checker::assumption>& assumptions, const sat_checker::unsat_core& core) {
+		std::vector<sat_checker::assumption> c;
+		for (auto& a: assumptions) {
+			if (core.includes(a.id))
+				c.push_back(a);
+		}
+		if (c.empty() || c.size() > MAX_CORE_SIZE || c.size() != core.size())
+			return;
+		std::lock_guard guard(this->mutex);
+		this->cores.push_back(std::move(c));
+		if (this->cores.size() > MAX_CORES)
+			this->cores.pop_front();
+	}
+
+	std::optional<sat_checker::unsat_core> find(const std::vector<sat_checker::assumption>& assumptions) {
+		std::lock_guard guard(this->mutex);
+		for (auto& c: this->cores) {
+			std::unordered_set<std::string> ids;
+			for (auto& a: c) {
+				auto i = std::find(assumptions.begin(), assumptions.end(), a);
+				if (i == assumptions.end())
+					break;
+				ids.insert(i->id);
+			}
+			if (ids.size() == c.size())
+				return sat_checker::unsat_core(std::move(ids));
+		}
+		return {};
+	}
+
+	static learned_cores& get() {
+		static learned_cores l;
+		return l;
+	}
+};
+
 bool state::exec::check_sat(const decltype(assumptions)& assumptions, bool minimize_unsat_prefix) {
 	if (this->sat)
 		return *this->sat;
@@ -355,7 +522,18 @@ bool state::exec::check_sat(const decltype(assumptions)& assumptions, bool minim
 		return *this->sat;
 	}
 
-	auto result = o_sat_strategy().check_sat(*this, assumptions, minimize_unsat_prefix);
+	if (o_learned_unsat_cores) {
+		static stats::counter s_learned_unsat("z3.learned_unsat");
+		if (auto core = learned_cores::get().find(assumptions)) {
+			s_learned_unsat.count();
+			this->sat = false;
+			this->model = {};
+			this->unsat_core = std::move(core);
+			return *this->sat;
+		}
+	}
+
+	auto result = o_sat_strategy().check_sat(*this, assumptions, minimize_unsat_prefix, false);
 
 	this->sat = result.sat;
 	if (*this->sat) {
@@ -372,6 +550,9 @@ bool state::exec::check_sat(const decltype(assumptions)& assumptions, bool minim
 	} else {
 		this->model = {};
 		this->unsat_core = std::move(result.unsat_core);
+		// without minimizing the core only names the last assumption
+		if (o_learned_unsat_cores && minimize_unsat_prefix && this->unsat_core)
+			learned_cores::get().learn(assumptions, *this->unsat_core);
 	}
 
 	return *this->sat;
@@ -381,10 +562,35 @@ bool state::exec::check_sat(bool minimize_unsat_prefix) {
 	return check_sat(this->assumptions, minimize_unsat_prefix);
 }
 
+// the model of a satisfiable check only holds the minimized value, solve again for the rest
+void state::exec::fetch_model() {
+	if (this->model && this->model->is_complete())
+		return;
+	if (this->assumptions.empty()) {
+		this->model = sat_checker::model();
+		return;
+	}
+	static stats::counter s_fetched("z3.fetched_models");
+	s_fetched.count();
+
+	auto result = o_sat_strategy().check_sat(*this, this->assumptions, false, true);
+	if (!result.sat)
+		errx(-1, "satisfiable state became unsatisfiable");
+	this->model = std::move(result.model);
+}
+
+/* the packet size only changes with assumptions added since the last
+ * minimization, branches decided by abstract values add none */
 void state::exec::partial_minimize() {
 	if (this->sat)
 		return;
 
+	static stats::counter s_skipped("static.skipped-minimize");
+	if (this->minimized == this->assumptions.size()) {
+		s_skipped.count();
+		return;
+	}
+
 	bool minimizes = false;
 	decltype(this->assumptions) assumptions;
 	assumptions.reserve(this->assumptions.size());
@@ -400,6 +606,21 @@ void state::exec::partial_minimize() {
 
 	if (minimizes)
 		check_sat(assumptions, false);
+	this->minimized = this->assumptions.size();
+}
+
+std::optional<bool> state::exec::is_sat() const {
+	return this->sat;
+}
+
+// result of partial_minimize for the same state known from an earlier run
+void state::exec::assume_minimized(std::optional<bool> sat, std::uint32_t min_value) {
+	this->minimized = this->assumptions.size();
+	if (!sat)
+		return;
+	this->sat = sat;
+	this->model = sat_checker::model();
+	this->min_value = std::max(this->min_value, min_value);
 }
 
 std::uint32_t state::exec::minimum_value() const {
@@ -407,20 +628,18 @@ std::uint32_t state::exec::minimum_value() const {
 }
 
 std::optional<std::uint64_t> state::exec::get_value(std::string name) {
-	if (!this->model)
-		check_sat(false);
+	if (!this->model || !this->model->includes(name))
+		fetch_model();
 	return this->model->get_value(name);
 }
 
 std::optional<std::uint64_t> state::exec::get_value(std::string name, std::uint64_t offset) {
-	if (!this->model)
-		check_sat(false);
+	fetch_model();
 	return this->model->get_value(name, offset);
 }
 
 std::map<std::uint64_t,std::uint64_t> state::exec::get_values(std::string name) {
-	if (!this->model)
-		check_sat(false);
+	fetch_model();
 	return std::move(this->model->get_values(name));
 }
 
@@ -430,7 +649,15 @@ bool state::exec::in_unsat_core(const instr& n, std::size_t loopdepth, bool bran
 	return this->unsat_core->includes(assumption_name(n, loopdepth, branchtrue));
 }
 
-state::sat_strategy::result state::sat_strategy::unsat_core::check_sat(const state::exec& state, const std::vector<sat_checker::assumption>& assumptions, bool minimize_unsat_prefix) {
+sat_checker::model state::sat_strategy::get_model(const state::exec& state, bool full_model) {
+	if (full_model)
+		return c.get_model();
+	if (!state.minimize)
+		return c.get_model(std::vector<std::string>());
+	return c.get_model({state.minimize->declname});
+}
+
+state::sat_strategy::result state::sat_strategy::unsat_core::check_sat(const state::exec& state, const std::vector<sat_checker::assumption>& assumptions, bool minimize_unsat_prefix, bool full_model) {
 	c.reset();
 	if (minimize_unsat_prefix)
 		c.enable_unsat_cores();
@@ -473,7 +700,7 @@ state::sat_strategy::result state::sat_strategy::unsat_core::check_sat(const sta
 	}
 
 	if (sat) {
-		return result(c.get_model());
+		return result(get_model(state, full_model));
 	} else {
 		if (minimize_unsat_prefix) {
 			return c.get_unsat_core();
@@ -483,7 +710,7 @@ state::sat_strategy::result state::sat_strategy::unsat_core::check_sat(const sta
 	}
 }
 
-state::sat_strategy::result state::sat_strategy::incremental::check_sat(const state::exec& state, const std::vector<sat_checker::assumption>& assumptions_, bool minimize_unsat_prefix) {
+state::sat_strategy::result state::sat_strategy::incremental::check_sat(const state::exec& state, const std::vector<sat_checker::assumption>& assumptions_, bool minimize_unsat_prefix, bool full_model) {
 	std::shared_ptr<const class expr::defs> parent_defs = this->start_defs;
 
 	if (this->minimize != state.minimize) {
@@ -538,14 +765,19 @@ state::sat_strategy::result state::sat_strategy::incremental::check_sat(const st
 	}
 
 	if (si != this->stack.end()) {
-		if (this->model)
+		// the deeper model also satisfies this prefix
+		if (this->model && (this->model->is_complete() || !full_model))
+			return result(*this->model);
+		if (this->model) {
+			this->model = get_model(state, full_model);
 			return result(*this->model);
+		}
 		c.pop(this->stack.end() - si);
 		this->stack.erase(si, this->stack.end());
 	}
 
 	if (c.check_sat()) {
-		this->model = c.get_model();
+		this->model = get_model(state, full_model);
 		return result(*this->model);
 	}
 
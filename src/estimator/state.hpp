@@ -21,6 +21,7 @@ public:
 
 	class perf;
 	class exec;
+	template<class V> class snapshot;
 
 	class deposit {
 	public:
@@ -35,6 +36,7 @@ public:
 	class update;
 	using uptr = std::shared_ptr<const class update>;
 	class update {
+		friend class state;
 		friend class state::exec;
 	public:
 		class defered;
@@ -87,6 +89,9 @@ public:
 	static uptr defer(unsigned int cycles, uptr u) {
 		return std::make_shared<const update::defered>(cycles, u);
 	}
+	static uptr undef(uptr u, const std::string& reason) {
+		return u->to_undef(reason);
+	}
 	using updates = std::vector<uptr>;
 
 	class update::defered : public update {
@@ -176,7 +181,7 @@ public:
 		};
 	};
 
-	class update::invalidate_mem: public update, std::enable_shared_from_this<invalidate_mem> {
+	class update::invalidate_mem: public update, public std::enable_shared_from_this<invalidate_mem> {
 	private:
 		const std::string& reason;
 		expr::eptr e;
@@ -197,6 +202,61 @@ public:
 		};
 	};
 
+	/* a map stored as a delta over a chain of shared, frozen parents
+	 * copies only copy the delta, lookups walk the chain from the newest layer */
+	template<class V>
+	class snapshot {
+		using map = std::map<const std::string,V>;
+		struct layer {
+			map entries;
+			std::shared_ptr<const layer> parent;
+			std::size_t depth;
+		};
+		static const std::size_t MAX_DEPTH = 8;
+		map delta = {};
+		std::shared_ptr<const layer> parent = nullptr;
+	public:
+		const V* find(const std::string& key) const {
+			auto i = this->delta.find(key);
+			if (i != this->delta.end())
+				return &i->second;
+			for (const layer* l = this->parent.get(); l; l = l->parent.get()) {
+				auto e = l->entries.find(key);
+				if (e != l->entries.end())
+					return &e->second;
+			}
+			return nullptr;
+		}
+
+		V& operator[](const std::string& key) {
+			return this->delta[key];
+		}
+
+		void clear() {
+			this->delta.clear();
+			this->parent = nullptr;
+		}
+
+		map flatten() const {
+			map m = this->delta;
+			for (const layer* l = this->parent.get(); l; l = l->parent.get())
+				m.insert(l->entries.begin(), l->entries.end());
+			return m;
+		}
+
+		void freeze() {
+			if (this->delta.empty())
+				return;
+			std::size_t depth = this->parent ? this->parent->depth+1 : 0;
+			if (depth >= MAX_DEPTH) {
+				this->parent = std::make_shared<const layer>(layer{flatten(), nullptr, 0});
+			} else {
+				this->parent = std::make_shared<const layer>(layer{std::move(this->delta), this->parent, depth});
+			}
+			this->delta = {};
+		}
+	};
+
 	struct sat_strategy {
 		struct result {
 			bool sat;
@@ -214,7 +274,8 @@ public:
 
 		sat_checker c = {};
 
-		virtual result check_sat(const state::exec& state, const std::vector<sat_checker::assumption>& assumptions, bool minimize_unsat_prefix) =  0;
+		virtual result check_sat(const state::exec& state, const std::vector<sat_checker::assumption>& assumptions, bool minimize_unsat_prefix, bool full_model) =  0;
+		sat_checker::model get_model(const state::exec& state, bool full_model);
 
 		class unsat_core;
 		class incremental;
@@ -222,7 +283,7 @@ public:
 
 
 	class sat_strategy::unsat_core : public sat_strategy {
-		result check_sat(const state::exec& state, const std::vector<sat_checker::assumption>& assumptions, bool minimize_unsat_prefix) override;
+		result check_sat(const state::exec& state, const std::vector<sat_checker::assumption>& assumptions, bool minimize_unsat_prefix, bool full_model) override;
 	};
 
 	class sat_strategy::incremental : public sat_strategy {
@@ -238,7 +299,7 @@ public:
 		};
 		std::vector<stack_t> stack = {};
 
-		result check_sat(const state::exec& state, const std::vector<sat_checker::assumption>& assumptions, bool minimize_unsat_prefix) override;
+		result check_sat(const state::exec& state, const std::vector<sat_checker::assumption>& assumptions, bool minimize_unsat_prefix, bool full_model) override;
 	};
 
 	class perf {
@@ -275,27 +336,31 @@ public:
 		unsigned int sumcycles = 0;
 		unsigned int lastmem = 0;
 		unsigned int lastcc = 0;
-		std::map<const std::string,expr::bvptr<32>> registers = {};
-		std::map<const std::string,expr::bvptr<1>> flags = {};
-		std::map<const std::string,expr::aptr<32,8>> mem8 = {};
-		std::map<const std::string,expr::aptr<32,32>> mem32 = {};
+		snapshot<expr::bvptr<32>> registers = {};
+		snapshot<expr::bvptr<1>> flags = {};
+		snapshot<expr::aptr<32,8>> mem8 = {};
+		snapshot<expr::aptr<32,32>> mem32 = {};
 		std::string mem_undef_reasons = {};
 		std::vector<std::pair<unsigned int,uptr>> defered = {};
 		std::shared_ptr<const struct expr::bvvariable<14>> minimize = nullptr;
 		std::uint32_t min_value = 0;
 		std::uint32_t max_value = std::numeric_limits<std::uint32_t>::max();
 		std::vector<sat_checker::assumption> assumptions = {};
+		std::size_t minimized = 0;
 		std::optional<bool> sat = {};
 		std::optional<sat_checker::model> model = {};
 		std::optional<sat_checker::unsat_core> unsat_core = {};
 
 		void assume(const sat_checker::assumption& a);
+		expr::ranges abstraction() const;
 		static std::string assumption_name(const instr& n, std::size_t loopdepth, bool branchtrue);
 	public:
 		exec() = default;
 		exec(unsigned int cycles, double dram_cycles, updates input, std::shared_ptr<const struct expr::bvvariable<14>> minimize, std::uint32_t min_value, std::uint32_t max_value, std::initializer_list<sat_checker::assumption> assumptions);
 		void apply(const instr& n, const perf::info& i, std::size_t loopdepth, bool branchtrue=false) override;
-		virtual state::exec static_merge(const state::exec& o) const;
+		virtual state::exec static_merge(const state::exec& o, bool widen=false) const;
+		std::optional<state::exec> path_merge(const state::exec& o, std::size_t budget) const;
+		void freeze();
 		unsigned int cycles() const;
 		expr::bvptr<32> operator[](const deposit::reg& d) const;
 		expr::bvptr<1> operator[](const deposit::flag& d) const;
@@ -307,7 +372,10 @@ public:
 		bool check_sat(const decltype(assumptions)& assumptions, bool minimize_unsat_prefix);
 	public:
 		bool check_sat(bool minimize_unsat_prefix);
+		void fetch_model();
 		void partial_minimize();
+		void assume_minimized(std::optional<bool> sat, std::uint32_t min_value);
+		std::optional<bool> is_sat() const;
 		std::uint32_t minimum_value() const;
 		std::optional<std::uint64_t> get_value(std::string name);
 		std::optional<std::uint64_t> get_value(std::string name, std::uint64_t offset);
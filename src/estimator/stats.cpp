@@ -52,6 +52,7 @@ std::string stats::counter::str() const {
 }
 
 void stats::clock::add(clockid_t clk_id) {
+	std::lock_guard lock(this->mutex);
 	struct timespec tp;
 
 	if (!this->clocks.insert(clk_id).second)
@@ -62,7 +63,9 @@ void stats::clock::add(clockid_t clk_id) {
 	this->time -= tp.tv_sec + (tp.tv_nsec/1000000000.0);
 }
 
+// before the thread exits or the process is reaped, as its clock ends with it
 void stats::clock::remove(clockid_t clk_id) {
+	std::lock_guard lock(this->mutex);
 	struct timespec tp;
 
 	if (!this->clocks.erase(clk_id))
@@ -74,6 +77,7 @@ void stats::clock::remove(clockid_t clk_id) {
 }
 
 std::string stats::clock::str() const {
+	std::lock_guard lock(this->mutex);
 	double t = this->time;
 	for (auto clk_id: this->clocks) {
 		struct timespec tp;
@@ -96,6 +100,13 @@ void stats::cputime::add(pid_t pid) {
 	clock::add(clk_id);
 }
 
+void stats::cputime::remove(pid_t pid) {
+	clockid_t clk_id;
+	if (clock_getcpuclockid(pid, &clk_id))
+		err(-1, "clock_getcpuclockid(%u)", pid);
+	clock::remove(clk_id);
+}
+
 stats::threadtime::threadtime(const std::string& name, std::thread::native_handle_type handle)
 	: clock(name) {
 	add(handle);
@@ -108,12 +119,22 @@ void stats::threadtime::add(std::thread::native_handle_type handle) {
 	clock::add(clk_id);
 }
 
+void stats::threadtime::remove(std::thread::native_handle_type handle) {
+	clockid_t clk_id;
+	if (pthread_getcpuclockid(handle, &clk_id))
+		err(-1, "pthread_getcpuclockid");
+	clock::remove(clk_id);
+}
+
 stats::maxmem::maxmem(const std::string& name, pid_t pid)
 	: stats(name) {
 	add(pid);
 }
 
+static size_t getVmHWM(int fd);
+
 void stats::maxmem::add(pid_t pid) {
+	std::lock_guard lock(this->mutex);
 	std::string filename = "/proc/" + (pid ? std::to_string(pid) : "self") + "/status";
 	int fd = open(filename.c_str(), O_RDONLY);
 	if (fd == -1)
@@ -121,15 +142,20 @@ void stats::maxmem::add(pid_t pid) {
 	this->fds[pid] = fd;
 }
 
+// before the process is reaped, keeping its peak
 void stats::maxmem::remove(pid_t pid) {
+	std::lock_guard lock(this->mutex);
 	auto i = this->fds.find(pid);
+	if (i == this->fds.end())
+		return;
+	this->removed += getVmHWM(i->second);
 	if (close(i->second))
 		err(-1, "close(/proc/*/status)");
 	this->fds.erase(i);
 }
 
 static size_t getVmHWM(int fd) {
-	static std::vector<char> buf = std::vector<char>(4096, 0);
+	thread_local std::vector<char> buf = std::vector<char>(4096, 0);
 
 retry:
 	char* l = buf.data();
@@ -167,7 +193,8 @@ retry:
 }
 
 std::string stats::maxmem::str() const {
-	size_t maxmem = 0;
+	std::lock_guard lock(this->mutex);
+	size_t maxmem = this->removed;
 	for (auto [pid, fd]: this->fds)
 		maxmem += getVmHWM(fd);
 	return std::to_string(maxmem) + " kB";
@@ -39,6 +39,7 @@ public:
 };
 
 class stats::clock : stats {
+	mutable std::mutex mutex = {};
 	std::set<clockid_t> clocks = {};
 	double time = 0;
 public:
@@ -54,6 +55,7 @@ public:
 	using clock::clock;
 	cputime(const std::string& name, pid_t pid);
 	void add(pid_t pid);
+	void remove(pid_t pid);
 };
 
 class stats::threadtime : clock {
@@ -61,10 +63,14 @@ public:
 	using clock::clock;
 	threadtime(const std::string& name, std::thread::native_handle_type handle);
 	void add(std::thread::native_handle_type handle);
+	void remove(std::thread::native_handle_type handle);
 };
 
 class stats::maxmem : stats {
+	mutable std::mutex mutex = {};
 	std::map<pid_t,int> fds = {};
+	// of the processes removed
+	std::size_t removed = 0;
 public:
 	using stats::stats;
 	maxmem(const std::string& name, pid_t pid);
@@ -4,31 +4,83 @@
 #include <mutex>
 #include <condition_variable>
 #include <functional>
+#include <atomic>
+#include <memory>
+#include <deque>
+#include <vector>
+#include <err.h>
 
 //LDLIBS=pthread
 
 
-void thread_pool::thread_handler() {
-	std::unique_lock lock(this->mutex);
+thread_local const thread_pool* thread_pool::local_pool = nullptr;
+thread_local std::size_t thread_pool::local = 0;
+
+std::size_t thread_pool::self() const {
+	if (local_pool != this)
+		return this->workers.size();
+	return local;
+}
+
+// self may be workers.size() for threads outside the pool, which only steal
+bool thread_pool::take(std::size_t self, std::function<void()>& f) {
+	for (std::size_t p = 0; p < PRIORITIES; p++) {
+		if (self < this->workers.size()) {
+			worker& w = *this->workers[self];
+			std::lock_guard guard(w.mutex);
+			if (!w.tasks[p].empty()) {
+				f.swap(w.tasks[p].back());
+				w.tasks[p].pop_back();
+				return true;
+			}
+		}
+		for (std::size_t i = 1; i <= this->workers.size(); i++) {
+			std::size_t o = (self + i) % (this->workers.size() + 1);
+			if (o == this->workers.size())
+				continue;
+			worker& w = *this->workers[o];
+			std::lock_guard guard(w.mutex);
+			if (!w.tasks[p].empty()) {
+				f.swap(w.tasks[p].front());
+				w.tasks[p].pop_front();
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void thread_pool::perform(std::function<void()>& f) {
+	this->pending -= 1;
+	f();
+	if (++this->performed == this->delegated) {
+		std::lock_guard guard(this->mutex);
+		this->cw.notify_all();
+	}
+}
+
+void thread_pool::thread_handler(std::size_t self) {
+	local_pool = this;
+	local = self;
 
 	for (;;) {
-		this->cf.wait(lock, [this] {return this->f || this->quit;});
-		if (this->quit)
-			break;
+		{
+			std::unique_lock lock(this->mutex);
+			this->cf.wait(lock, [this] {return this->pending || this->quit;});
+			if (this->quit)
+				break;
+		}
 		std::function<void()> f;
-		f.swap(this->f);
-		lock.unlock();
-		this->cd.notify_one();
-		f();
-		lock.lock();
-		this->performed += 1;
-		this->cw.notify_one();
+		if (take(self, f))
+			perform(f);
 	}
 }
 
 thread_pool::thread_pool(std::size_t size) {
 	for (std::size_t i = 0; i < size; i++)
-		this->threads.emplace_back(&thread_pool::thread_handler, this);
+		this->workers.push_back(std::make_unique<worker>());
+	for (std::size_t i = 0; i < size; i++)
+		this->threads.emplace_back(&thread_pool::thread_handler, this, i);
 }
 
 thread_pool::~thread_pool() {
@@ -41,21 +93,27 @@ thread_pool::~thread_pool() {
 		t.join();
 }
 
-void thread_pool::delegate(std::function<void()> f) {
+void thread_pool::delegate(std::function<void()> f, priority p) {
 	if (!this->threads.size()) {
 		f();
 		return;
 	}
+	this->delegated += 1;
+	std::size_t self = this->self();
+	if (self == this->workers.size())
+		self = this->submitted++ % this->workers.size();
 	{
-		std::unique_lock lock(this->mutex);
-		this->delegated += 1;
-		this->f = f;
+		worker& w = *this->workers[self];
+		std::lock_guard guard(w.mutex);
+		w.tasks[p].push_back(std::move(f));
 	}
-	this->cf.notify_one();
 	{
-		std::unique_lock lock(this->mutex);
-		this->cd.wait(lock, [this] {return !this->f;});
+		std::lock_guard guard(this->mutex);
+		this->pending += 1;
+		if (this->helpers)
+			this->cw.notify_all();
 	}
+	this->cf.notify_one();
 }
 
 void thread_pool::wait() {
@@ -64,6 +122,75 @@ void thread_pool::wait() {
 	this->cw.wait(lock, [this] {return this->delegated == this->performed;});
 }
 
+/* runs f once on every thread of an idle pool, e.g. to set up thread local
+ * state, as a thread waits for the others once it ran f. From a thread of
+ * the pool, the barrier would never be reached. */
+void thread_pool::each(std::function<void()> f) {
+	if (local_pool == this)
+		errx(-1, "thread_pool::each() called from a thread of its pool");
+	struct barrier {
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::size_t arrived = 0;
+		std::size_t left = 0;
+	};
+	auto b = std::make_shared<barrier>();
+	const std::size_t n = this->threads.size();
+	for (std::size_t i = 0; i < n; i++) {
+		delegate([b,f,n] {
+			f();
+			std::unique_lock lock(b->mutex);
+			if (++b->arrived == n)
+				b->cv.notify_all();
+			b->cv.wait(lock, [b,n] {return b->arrived == n;});
+			if (++b->left == n)
+				b->cv.notify_all();
+		}, HIGH);
+	}
+	std::unique_lock lock(b->mutex);
+	b->cv.wait(lock, [b,n] {return b->left == n;});
+}
+
+thread_pool::group::group(thread_pool& pool)
+	: pool(pool) {}
+
+thread_pool::group::~group() {
+	wait();
+}
+
+void thread_pool::group::delegate(std::function<void()> f, priority p) {
+	if (!this->pool.threads.size()) {
+		f();
+		return;
+	}
+	this->outstanding += 1;
+	this->pool.delegate([this,f] {
+		f();
+		// the group may be gone once outstanding drops to zero
+		thread_pool& pool = this->pool;
+		if (--this->outstanding == 0) {
+			std::lock_guard guard(pool.mutex);
+			pool.cw.notify_all();
+		}
+	}, p);
+}
+
+void thread_pool::group::wait() {
+	std::size_t self = this->pool.self();
+	std::function<void()> f;
+
+	while (this->outstanding) {
+		if (this->pool.take(self, f)) {
+			this->pool.perform(f);
+			continue;
+		}
+		std::unique_lock lock(this->pool.mutex);
+		this->pool.helpers += 1;
+		this->pool.cw.wait(lock, [this] {return !this->outstanding || this->pool.pending;});
+		this->pool.helpers -= 1;
+	}
+}
+
 std::vector<std::thread::native_handle_type> thread_pool::thread_handles() {
 	std::vector<std::thread::native_handle_type> handles;
 
@@ -72,4 +199,3 @@ std::vector<std::thread::native_handle_type> thread_pool::thread_handles() {
 
 	return handles;
 }
-
@@ -4,28 +4,57 @@
 #include <mutex>
 #include <condition_variable>
 #include <functional>
-#include <map>
+#include <atomic>
+#include <memory>
+#include <deque>
+#include <vector>
+#include <optional>
+#include <algorithm>
 
 #include <iostream>
 
 class thread_pool {
+public:
+	enum priority {
+		HIGH,
+		NORMAL,
+		LOW,
+	};
+	static const std::size_t PRIORITIES = LOW+1;
 private:
+	/* tasks delegated by a worker go to its own deque and are taken LIFO,
+	 * idle workers steal the oldest tasks of the others */
+	struct worker {
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks[PRIORITIES];
+	};
+	static thread_local const thread_pool* local_pool;
+	static thread_local std::size_t local;
+
 	std::mutex mutex;
 	std::condition_variable cf;
-	std::condition_variable cd;
 	std::condition_variable cw;
+	std::vector<std::unique_ptr<worker>> workers = {};
 	std::vector<std::thread> threads = {};
-	unsigned long delegated = 0;
-	unsigned long performed = 0;
-	std::function<void()> f;
+	std::atomic<unsigned long> delegated = 0;
+	std::atomic<unsigned long> performed = 0;
+	std::atomic<unsigned long> pending = 0;
+	std::atomic<unsigned long> submitted = 0;
+	unsigned long helpers = 0;
 	bool quit = false;
 
-	void thread_handler();
+	std::size_t self() const;
+	bool take(std::size_t self, std::function<void()>& f);
+	void perform(std::function<void()>& f);
+	void thread_handler(std::size_t self);
 public:
+	class group;
+
 	thread_pool(std::size_t size);
 	~thread_pool();
-	void delegate(std::function<void()> f);
+	void delegate(std::function<void()> f, priority p=NORMAL);
 	void wait();
+	void each(std::function<void()> f);
 	std::vector<std::thread::native_handle_type> thread_handles();
 	template <typename TI, typename TO, typename C>
 	void complete_in_order(C container, std::function<TO(TI)> d, std::function<void(TO)> c);
@@ -38,74 +67,175 @@ public:
 	};
 };
 
+/* waits only for the tasks delegated through the group, running pending
+ * tasks of the pool meanwhile, so groups may be waited on from within tasks */
+class thread_pool::group {
+private:
+	thread_pool& pool;
+	std::atomic<unsigned long> outstanding = 0;
+public:
+	group(thread_pool& pool);
+	~group();
+	void delegate(std::function<void()> f, priority p=NORMAL);
+	void wait();
+};
+
 template <typename T>
 class thread_pool::orderered_completion_state {
 	friend thread_pool;
 private:
+	/* results wait in a ring of slots indexed by sequence number, whoever
+	 * finds the next slot ready drains the ring in order */
+	struct slot {
+		std::atomic<unsigned long> ready = 0; // index+1 once the result is stored
+		std::optional<T> result = {};
+		std::function<void(T, unsigned long)> c = nullptr;
+		std::function<void(unsigned long)> s = nullptr;
+	};
 	thread_pool& pool;
-	unsigned long started = 0;
-	unsigned long completed = 0;
+	const unsigned long size;
+	std::atomic<unsigned long> started = 0;
+	std::atomic<unsigned long> completed = 0;
+	std::atomic<bool> draining = false;
+	std::atomic<unsigned long> active = 0;
+	std::atomic<unsigned long> waiters = 0;
+	std::unique_ptr<slot[]> slots;
 	std::mutex mutex;
-	std::map<unsigned long,std::function<void(unsigned long)>> results;
+	std::condition_variable cc;
 
 	orderered_completion_state(thread_pool& pool)
-		: pool(pool) {}
+		: pool(pool),
+		  size(std::max(64LU, 16*pool.threads.size())),
+		  slots(std::make_unique<slot[]>(size)) {}
 
-	void sync(std::function<void(unsigned long)> c, unsigned int index) {
-		{
-			std::lock_guard guard(this->mutex);
-			if (index  > this->completed) {
-				this->results[index] = c;
+	slot& reserve(unsigned long index) {
+		if (index >= this->size)
+			wait(index - this->size + 1);
+		return this->slots[index % this->size];
+	}
+
+	void drain() {
+		for (;;) {
+			bool expected = false;
+			if (!this->draining.compare_exchange_strong(expected, true))
 				return;
-			}
-			c(index);
-			this->completed++;
-			for (auto r = this->results.begin(); r != this->results.end(); r = this->results.erase(r)) {
-				if (r->first != this->completed)
+			unsigned long c = this->completed;
+			for (;;) {
+				slot& s = this->slots[c % this->size];
+				if (s.ready != c+1)
 					break;
-				r->second(this->completed);
-				this->completed++;
+				if (s.s) {
+					s.s(c);
+					s.s = nullptr;
+				} else {
+					s.c(std::move(*s.result), c);
+					s.c = nullptr;
+					s.result.reset();
+				}
+				s.ready = 0;
+				this->completed = ++c;
+			}
+			this->draining = false;
+			if (this->waiters) {
+				std::lock_guard guard(this->mutex);
+				this->cc.notify_all();
 			}
+			if (this->slots[c % this->size].ready != c+1)
+				return;
+		}
+	}
+
+	// a drained ring and the last completer leaving wake the waiters
+	void leave() {
+		if (--this->active == 0 && this->waiters) {
+			std::lock_guard guard(this->mutex);
+			this->cc.notify_all();
 		}
 	}
 
+	void complete(unsigned long index) {
+		this->active++;
+		this->slots[index % this->size].ready = index+1;
+		drain();
+		leave();
+	}
+
+	// blocks instead of spinning, a drain may run a whole sat check
+	template<typename P>
+	void block(P p) {
+		std::unique_lock lock(this->mutex);
+		this->waiters++;
+		this->cc.wait(lock, p);
+		this->waiters--;
+	}
+
 public:
+	~orderered_completion_state() {
+		if (this->active)
+			block([this] {return !this->active;});
+	}
+
+	/* completions stay lock-free, they leave the ring to the holder of the
+	 * lock, which drains it on unlocking */
 	template<typename F>
 	auto lock(F c) {
-		{
-			std::lock_guard guard(this->mutex);
-			return c();
-		}
+		for (bool expected = false; !this->draining.compare_exchange_strong(expected, true); expected = false)
+			block([this] {return !this->draining;});
+		struct unlock {
+			orderered_completion_state& o;
+			~unlock() {
+				o.draining = false;
+				o.active++;
+				o.drain();
+				o.leave();
+			}
+		} u{*this};
+		return c();
 	}
 
 	void sync(std::function<void(unsigned long)> c) {
-		unsigned int index = this->started++;
-		sync(c, index);
+		unsigned long index = this->started++;
+		reserve(index).s = c;
+		complete(index);
 	}
 
-	void delegate(std::function<T()> d, std::function<void(T, unsigned long)> c) {
-		unsigned int index = this->started++;
-		pool.delegate([this,index,d,c] {
-			T e = d();
-			sync([c, e] (unsigned long i) {
-				c(e, i);
-			}, index);
-		});
+	void delegate(std::function<T()> d, std::function<void(T, unsigned long)> c, thread_pool::priority p=thread_pool::NORMAL) {
+		unsigned long index = this->started++;
+		reserve(index).c = c;
+		pool.delegate([this,index,d] {
+			this->slots[index % this->size].result.emplace(d());
+			complete(index);
+		}, p);
 	}
 
-	void may_delegate(std::function<T()> d, std::function<void(T, unsigned long)> c, bool may) {
+	void may_delegate(std::function<T()> d, std::function<void(T, unsigned long)> c, bool may, thread_pool::priority p=thread_pool::NORMAL) {
 		if (may) {
-			delegate(d, c);
+			delegate(d, c, p);
 		} else {
-			T e = d();
-			sync([c, e] (unsigned long i) {
-				c(e, i);
-			});
+			unsigned long index = this->started++;
+			slot& s = reserve(index);
+			s.c = c;
+			s.result.emplace(d());
+			complete(index);
 		}
 	}
 
 	bool waiting(std::size_t i) {
-		return this->results.find(i) != this->results.end();
+		return i < this->started && this->slots[i % this->size].ready == i+1;
+	}
+
+	unsigned long mark() const {
+		return this->started;
 	}
-};
 
+	// waits for the completions up to a mark only, unlike thread_pool::wait()
+	void wait(unsigned long mark) {
+		if (this->completed >= mark)
+			return;
+		block([this,mark] {return this->completed >= mark;});
+	}
+
+	void wait() {
+		wait(this->started);
+	}
+};
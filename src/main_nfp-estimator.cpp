@@ -1,20 +1,37 @@
 #include "estimator/cfg.hpp"
+#include "estimator/instr.hpp"
 #include "estimator/state.hpp"
 #include "estimator/sat_checker.hpp"
 #include "estimator/stats.hpp"
 #include "estimator/features.hpp"
+#include "estimator/thread_pool.hpp"
 #include "version.h"
 
 #include <iostream>
 #include <memory>
+#include <vector>
+#include <algorithm>
 #include <sstream>
 #include <fstream>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <new>
+#include <stdexcept>
+#include <ext/stdio_filebuf.h>
 #include <cstdlib>
 #include <cstring>
+#include <cerrno>
 #include <csignal>
 #include <ctime>
 #include <getopt.h>
+#include <poll.h>
+#include <unistd.h>
 #include <sys/sysinfo.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <openssl/sha.h>
 #include <err.h>
 
@@ -29,6 +46,31 @@ bool mem_available() {
 	return info.freeram + info.bufferram >= info.totalram/2;
 }
 
+static std::string sha256(const std::string& s) {
+	unsigned char hash[SHA256_DIGEST_LENGTH];
+	SHA256_CTX sha256;
+	SHA256_Init(&sha256);
+	SHA256_Update(&sha256, s.c_str(), s.size());
+	SHA256_Final(hash, &sha256);
+	std::ostringstream h;
+	for(int i = 0; i < SHA256_DIGEST_LENGTH; i++)
+		h <<  std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
+	return h.str();
+}
+
+// comma separated values of an option, the first one is used outside of sweeps
+template<typename T>
+static std::vector<T> values(const char* arg) {
+	std::vector<T> v;
+	for (;;) {
+		char* end;
+		v.push_back(std::strtoul(arg, &end, 10));
+		if (*end != ',')
+			return v;
+		arg = end+1;
+	}
+}
+
 static void usage(char *argv0) {
 	fprintf(stderr, "Usage: %s [mode] [options]\n", argv0);
 	fprintf(stderr, "Mode:\n");
@@ -38,19 +80,29 @@ static void usage(char *argv0) {
 	fprintf(stderr, "\t-i                 worst packet-rate analysis (DRAM & processors)\n");
 	fprintf(stderr, "\t-l                 worst packet-rate analysis (processors only)\n");
 	fprintf(stderr, "\t-p                 worst packet-rate analysis (DRAM only)\n");
+	fprintf(stderr, "\t-b                 worst packet-rate and bit-rate analysis in one pass\n");
+	fprintf(stderr, "\t-s                 worst bit-rate analysis with throughput bounds per packet size\n");
 	fprintf(stderr, "\t-g                 output cfg as DOT\n");
+	fprintf(stderr, "\t-B <manifest>      run the jobs of a manifest, one line of options each\n");
+	fprintf(stderr, "\t                   a job's -t replaces the threads of the batch\n");
+	fprintf(stderr, "\t-D <socket>        serve jobs, one line of options each, on a unix socket\n");
 	fprintf(stderr, "Options:\n");
 	fprintf(stderr, "\t-c <count=-1>      stop after count satisfiable paths\n");
-	fprintf(stderr, "\t-C <cycles=%3u>    per packet firmware cycles\n", cfg::COST_FIRMWARE);
+	fprintf(stderr, "\t-C <cycles=%3u>    per packet firmware cycles, comma separated to sweep\n", cfg::COST_FIRMWARE);
 	fprintf(stderr, "\t-f <file>          input asm file\n");
+	fprintf(stderr, "\t-H <file>          reuse results for unchanged code\n");
+	fprintf(stderr, "\t-j <jobs=1>        concurrent jobs of a batch or server\n");
+	fprintf(stderr, "\t-J <file>          stream bounds as JSON lines\n");
+	fprintf(stderr, "\t-K <file>          instruction cost table\n");
 	fprintf(stderr, "\t-L <analysis=Mode> 0: no, 1: without z3, 2: with z3\n");
-	fprintf(stderr, "\t-M <MTU=%4u>      set MTU\n", cfg::MTU);
+	fprintf(stderr, "\t-M <MTU=%4u>      set MTU, comma separated to sweep\n", cfg::MTU);
 	fprintf(stderr, "\t-o <file>          output file\n");
+	fprintf(stderr, "\t-R <file>          checkpoint every %us, resume if present\n", cfg::CHECKPOINT_INTERVAL);
 	fprintf(stderr, "\t-S                 print settings\n");
 	fprintf(stderr, "\t-t <threads=%zu>     number of threads\n", cfg::PARALLELISM);
 	fprintf(stderr, "\t-T <timeout>       terminate after timeout\n");
 	fprintf(stderr, "\t-U <unroll_limit>  unroll loops\n");
-	fprintf(stderr, "\t-w <workers=%2u>    NIC bpf workers\n", cfg::NUM_WORKERS);
+	fprintf(stderr, "\t-w <workers=%2u>    NIC bpf workers, comma separated to sweep\n", cfg::NUM_WORKERS);
 	fprintf(stderr, "\t-A                 debug symbolic assignments\n");
 	fprintf(stderr, "\t-I <id,...>        debug instructions\n");
 	fprintf(stderr, "\t-F <features>      configure features\n");
@@ -61,12 +113,30 @@ static void usage(char *argv0) {
 	exit(1);
 }
 
-int main(int argc, char** argv){
+// set in the worker processes of a batch or server
+static bool batch_job = false;
+static std::shared_ptr<thread_pool> batch_pool = nullptr;
+// threads of a job without -t, those of the batch or server
+static std::size_t batch_threads = 0;
+// input and output of a server job, and its cfg for cancelling it
+static std::istream* job_in = nullptr;
+static std::ostream* job_out = nullptr;
+static std::mutex running_mutex;
+static cfg* running = nullptr;
+// outcome of a job for its result line
+static bool job_finished = false;
+static std::string job_bound = "null";
+
+static int batch(const char* manifest, unsigned int jobs, char* argv0, std::ostream& out);
+static int serve(const char* socket, unsigned int jobs, char* argv0);
+
+static int analyze(int argc, char** argv){
 	static cfg* cfg;
-	std::istream *in = &std::cin;
+	std::istream *in = job_in ? job_in : &std::cin;
 	std::ifstream fin;
-	static std::ostream *out = &std::cout;
+	static std::ostream *out;
 	std::ofstream fout;
+	out = job_out ? job_out : &std::cout;
 	enum {
 		MODE_DOT = 0,
 		MODE_PACKETRATE = 1,
@@ -75,17 +145,31 @@ int main(int argc, char** argv){
 		MODE_BITRATE = 4,
 		MODE_PROC_BITRATE = 5,
 		MODE_DRAM_BITRATE = 6,
+		MODE_RATES = 7,
+		MODE_CURVE = 8,
 	} mode = MODE_BITRATE;
 	int static_analysis = -1;
 	bool print_settings = false;
 	long timeout = 0;
+	const char* checkpoint = nullptr;
+	const char* cache = nullptr;
+	const char* trajectory = nullptr;
+	const char* manifest = nullptr;
+	const char* socket = nullptr;
+	unsigned int jobs = 1;
+	std::chrono::time_point<std::chrono::steady_clock> deadline;
+	std::vector<unsigned int> workers, costs;
+	std::vector<std::uint32_t> mtus;
 	size_t count = -1;
 	int opt;
 
 	std::ios_base::sync_with_stdio(false);
 
-	while ((opt = getopt(argc, argv, "giklmpqc:C:f:L:M:o:St:T:U:w:AF:I:Z")) != -1) {
+	while ((opt = getopt(argc, argv, "bgiklmpqsB:c:C:D:f:H:j:J:K:L:M:o:R:St:T:U:w:AF:I:Z")) != -1) {
 		switch (opt) {
+		case 'b':
+			mode = MODE_RATES;
+			continue;
 		case 'g':
 			mode = MODE_DOT;
 			continue;
@@ -107,11 +191,21 @@ int main(int argc, char** argv){
 		case 'q':
 			mode = MODE_DRAM_BITRATE;
 			continue;
+		case 's':
+			mode = MODE_CURVE;
+			continue;
+		case 'B':
+			manifest = optarg;
+			continue;
 		case 'c':
 			sscanf(optarg, "%zu", &count);
 			continue;
 		case 'C':
-			sscanf(optarg, "%u", &cfg::COST_FIRMWARE);
+			costs = values<unsigned int>(optarg);
+			cfg::COST_FIRMWARE = costs.front();
+			continue;
+		case 'D':
+			socket = optarg;
 			continue;
 		case 'f':
 			fin.open(optarg, std::ios::in);
@@ -119,11 +213,27 @@ int main(int argc, char** argv){
 				err(-1, "opening %s ", optarg);
 			in = &fin;
 			continue;
+		case 'H':
+			cache = optarg;
+			continue;
+		case 'j':
+			sscanf(optarg, "%u", &jobs);
+			continue;
+		case 'J':
+			trajectory = optarg;
+			continue;
+		case 'K': {
+			std::ifstream costs(optarg, std::ios::in);
+			if (costs.fail())
+				err(-1, "opening %s ", optarg);
+			instr::load_costs(costs);
+			continue; }
 		case 'L':
 			sscanf(optarg, "%i", &static_analysis);
 			continue;
 		case 'M':
-			sscanf(optarg, "%" SCNu32, &cfg::MTU);
+			mtus = values<std::uint32_t>(optarg);
+			cfg::MTU = mtus.front();
 			continue;
 		case 'o':
 			fout.exceptions(std::ifstream::badbit);
@@ -132,6 +242,9 @@ int main(int argc, char** argv){
 				err(-1, "opening %s ", optarg);
 			out = &fout;
 			continue;
+		case 'R':
+			checkpoint = optarg;
+			continue;
 		case 'S':
 			print_settings = true;
 			continue;
@@ -163,7 +276,8 @@ int main(int argc, char** argv){
 			}
 			continue; }
 		case 'w':
-			sscanf(optarg, "%u", &cfg::NUM_WORKERS);
+			workers = values<unsigned int>(optarg);
+			cfg::NUM_WORKERS = workers.front();
 			continue;
 		case 'A':
 			state::debug_assignments = true;
@@ -196,15 +310,36 @@ int main(int argc, char** argv){
 	}
 	if (argc-optind != 0)
 		usage(argv[0]);
+	if ((manifest || socket) && batch_job)
+		errx(-1, "jobs cannot run batches or servers");
+	if (manifest)
+		return batch(manifest, std::max(jobs, 1U), argv[0], *out);
+	if (socket)
+		return serve(socket, std::max(jobs, 1U), argv[0]);
+	if (batch_job && out == &std::cout)
+		errx(-1, "batch jobs need an output file");
+	bool sweep = workers.size() > 1 || costs.size() > 1 || mtus.size() > 1;
+	if (sweep && (mode == MODE_DOT || checkpoint))
+		errx(-1, "a sweep can neither output the cfg nor be checkpointed");
+	if (mode == MODE_RATES && checkpoint)
+		errx(-1, "-b cannot be checkpointed");
+	if (workers.empty())
+		workers.push_back(cfg::NUM_WORKERS);
+	if (costs.empty())
+		costs.push_back(cfg::COST_FIRMWARE);
+	if (mtus.empty())
+		mtus.push_back(cfg::MTU);
 
 	std::string asm_listing(std::istreambuf_iterator<char>(*in), {});
 	if (in->fail())
 		err(-1, "reading");
 
 	if (static_analysis == -1)
-		static_analysis = (mode+2)/3;
+		static_analysis = std::min((mode+2)/3, 2);
 
 	std::signal(SIGINT, [](int) {
+		if (cfg)
+			cfg->write_checkpoint(true);
 		stats::write(*out);
 		std::quick_exit(128+SIGINT);
 	});
@@ -240,6 +375,12 @@ int main(int argc, char** argv){
 		case MODE_DRAM_BITRATE:
 			*out << "mode: DRAM bitrate\n";
 			break;
+		case MODE_RATES:
+			*out << "mode: packetrate and bitrate\n";
+			break;
+		case MODE_CURVE:
+			*out << "mode: bitrate curve\n";
+			break;
 		case MODE_DOT:
 			*out << "mode: cfg\n";
 			break;
@@ -258,23 +399,19 @@ int main(int argc, char** argv){
 
 		*out << "features: " << features::values() << "\n";
 		*out << "bpf-workers: " << cfg::NUM_WORKERS << "\n";
-		*out << "input: ";
-		unsigned char hash[SHA256_DIGEST_LENGTH];
-		SHA256_CTX sha256;
-		SHA256_Init(&sha256);
-		SHA256_Update(&sha256, asm_listing.c_str(), asm_listing.size());
-		SHA256_Final(hash, &sha256);
-		for(int i = 0; i < SHA256_DIGEST_LENGTH; i++)
-			*out <<  std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
-		*out << std::dec << "\n";
+		*out << "costs: " << instr::costs().str() << "\n";
+		*out << "input: " << sha256(asm_listing) << "\n";
 
 		*out << "\n" << std::flush;
 	}
 
-	if (timeout) {
+	if (timeout && batch_job) {
+		deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeout);
+	} else if (timeout) {
 		std::signal(SIGALRM, [](int) {
 			*out << "\n";
 			cfg->report_timeout();
+			cfg->write_checkpoint(true);
 			out->flush();
 			std::quick_exit(0);
 		});
@@ -282,41 +419,384 @@ int main(int argc, char** argv){
 		if (timer_create(CLOCK_MONOTONIC, NULL, &timerid))
 			err(-1, "timer_create(CLOCK_MONOTONIC)");
 		itimerspec timer_value = {{},{timeout,0}};
+		deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeout);
 		if (timer_settime(timerid, 0, &timer_value, NULL))
 			err(-1, "timer_settime(%lu)", timeout);
 	}
 
-	cfg = new std::remove_pointer<decltype(cfg)>::type(asm_listing, *out);
-	if (static_analysis >= 1)
-		cfg->static_analysis(static_analysis >= 2);
-	switch (mode) {
-	case MODE_DOT:
-		cfg->save_dot_graph();
-		break;
-	case MODE_PACKETRATE:
-		cfg->enumerate_by_packetrate(count);
-		break;
-	case MODE_BITRATE:
-		cfg->enumerate_by_bitrate(count);
-		break;
-	case MODE_PROC_PACKETRATE:
-		cfg->enumerate_by_proc_packetrate(count);
-		break;
-	case MODE_PROC_BITRATE:
-		cfg->enumerate_by_proc_bitrate(count);
-		break;
-	case MODE_DRAM_PACKETRATE:
-		cfg->enumerate_by_dram_packetrate(count);
-		break;
-	case MODE_DRAM_BITRATE:
-		cfg->enumerate_by_dram_bitrate(count);
-		break;
+	if (batch_pool) {
+		// a job's -t replaces the pool of the worker, with its z3 processes
+		if (batch_pool->thread_handles().size() != cfg::PARALLELISM)
+			batch_pool = std::make_shared<thread_pool>(cfg::PARALLELISM);
+		cfg = new std::remove_pointer<decltype(cfg)>::type(asm_listing, *out, batch_pool);
+	} else {
+		cfg = new std::remove_pointer<decltype(cfg)>::type(asm_listing, *out);
+	}
+	if (cache)
+		cfg->use_cache(cache);
+	if (trajectory)
+		cfg->stream_bounds(trajectory);
+	if (timeout)
+		cfg->set_deadline(deadline, batch_job);
+	{
+		std::lock_guard guard(running_mutex);
+		running = cfg;
+	}
+	auto enumerate = [&] {
+		switch (mode) {
+		case MODE_DOT:
+			cfg->save_dot_graph();
+			break;
+		case MODE_PACKETRATE:
+			cfg->enumerate_by_packetrate(count);
+			break;
+		case MODE_BITRATE:
+			cfg->enumerate_by_bitrate(count);
+			break;
+		case MODE_PROC_PACKETRATE:
+			cfg->enumerate_by_proc_packetrate(count);
+			break;
+		case MODE_PROC_BITRATE:
+			cfg->enumerate_by_proc_bitrate(count);
+			break;
+		case MODE_DRAM_PACKETRATE:
+			cfg->enumerate_by_dram_packetrate(count);
+			break;
+		case MODE_DRAM_BITRATE:
+			cfg->enumerate_by_dram_bitrate(count);
+			break;
+		case MODE_RATES:
+			cfg->enumerate_by_rates(count);
+			break;
+		case MODE_CURVE:
+			cfg->enumerate_curve(count);
+			break;
+		}
+	};
+
+	if (!sweep) {
+		if (static_analysis >= 1)
+			cfg->static_analysis(static_analysis >= 2);
+		if (checkpoint) {
+			std::ostringstream settings;
+			settings << mode << " " << static_analysis << " " << features::values() << " " << cfg::NUM_WORKERS << " " << cfg::COST_FIRMWARE << " " << cfg::MTU << " " << instr::costs().str() << " " << cfg::UNROLL_LIMIT;
+			for (auto [id, limit]: cfg::UNROLL_LIMITS)
+				settings << " " << limit << ":" << id;
+			settings << "\n";
+			cfg->resume(checkpoint, sha256(settings.str() + asm_listing));
+		}
+		enumerate();
+	} else {
+		// edges unsat for a larger MTU stay unsat, so the static analysis prunes further for each smaller one
+		std::sort(mtus.begin(), mtus.end(), std::greater<std::uint32_t>());
+		for (auto m: mtus) {
+			cfg->configure(cfg::NUM_WORKERS, cfg::COST_FIRMWARE, m);
+			if (static_analysis >= 1)
+				cfg->static_analysis(static_analysis >= 2);
+			for (auto w: workers) {
+				for (auto c: costs) {
+					cfg->configure(w, c, m);
+					*out << "#### Configuration\n";
+					*out << "bpf-workers: " << w << "\n";
+					*out << "firmware cycles: " << c << "\n";
+					*out << "MTU: " << m << "\n\n";
+					enumerate();
+				}
+			}
+		}
+	}
+	{
+		std::lock_guard guard(running_mutex);
+		running = nullptr;
 	}
+	job_finished = cfg->finished();
+	job_bound = cfg->final_bound();
 	delete cfg;
+	cfg = nullptr;
 
-	if (out->fail())
+	if (out->fail()) {
+		if (batch_job)
+			return 1;
 		errx(-1, "error writing output");
+	}
 
 	return 0;
 }
 
+// a malformed listing or cost table ends the job like the other errors
+static int run(int argc, char** argv) {
+	try {
+		return analyze(argc, argv);
+	} catch (const std::invalid_argument& e) {
+		errx(-1, "%s", e.what());
+	}
+}
+
+static std::string json_string(const std::string& s) {
+	std::string j = "\"";
+	for (char c: s) {
+		if (c == '"' || c == '\\')
+			j += '\\';
+		j += c;
+	}
+	return j + "\"";
+}
+
+/* Options stay set on the thread parsing them, so every job starts from
+ * the defaults saved before any option was parsed. */
+static cfg::settings* defaults;
+
+// -A, -I and -Z are not part of the settings of a cfg
+static void reset_job() {
+	defaults->apply();
+	cfg::PARALLELISM = batch_threads;
+	state::debug_assignments = false;
+	state::debug_instrs.clear();
+	sat_checker::debug = false;
+	job_finished = false;
+	job_bound = "null";
+}
+
+static const unsigned long NO_JOB = -1UL;
+
+/* Takes jobs until none are left, keeping its thread pool and with it the
+ * z3 processes of the threads across jobs. Jobs run with the -t of the
+ * batch, one with its own -t gets a new pool. A failing job exits the
+ * worker, which is then replaced. */
+[[noreturn]] static void worker(const std::vector<std::string>& jobs, std::atomic<unsigned long>& next, std::atomic<unsigned long>& current, int results, char* argv0) {
+	batch_job = true;
+	batch_threads = cfg::PARALLELISM;
+	batch_pool = std::make_shared<thread_pool>(batch_threads);
+	for (unsigned long j; (j = next++) < jobs.size();) {
+		current = j;
+		auto begun = std::chrono::steady_clock::now();
+
+		std::istringstream line(jobs[j]);
+		std::vector<std::string> args;
+		for (std::string arg; line >> arg;)
+			args.push_back(arg);
+		std::vector<char*> argv = {argv0};
+		for (auto& arg: args)
+			argv.push_back(arg.data());
+		argv.push_back(nullptr);
+
+		reset_job();
+		optind = 0;
+		int status = run(argv.size()-1, argv.data());
+
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begun;
+		std::ostringstream r;
+		r << "{\"job\":" << j << ",\"status\":\"" << (status ? "failed" : "ok") << "\",\"time\":" << elapsed.count() << ",\"finished\":" << (job_finished ? "true" : "false") << ",\"bound\":" << job_bound << ",\"args\":" << json_string(jobs[j]) << "}\n";
+		std::string rs = r.str();
+		if (write(results, rs.data(), rs.size()) != (ssize_t) rs.size())
+			err(-1, "write()");
+		current = NO_JOB;
+	}
+	std::exit(0);
+}
+
+/* Runs the jobs of a manifest in worker processes and writes one JSON
+ * line per job, lines starting with # are ignored. */
+static int batch(const char* manifest, unsigned int jobs, char* argv0, std::ostream& out) {
+	std::ifstream m(manifest, std::ios::in);
+	if (m.fail())
+		err(-1, "opening %s", manifest);
+	std::vector<std::string> lines;
+	for (std::string line; std::getline(m, line);) {
+		auto hash = line.find('#');
+		if (hash != std::string::npos)
+			line.erase(hash);
+		if (line.find_first_not_of(" \t") != std::string::npos)
+			lines.push_back(line);
+	}
+
+	// the next job and the job of each worker, shared with the workers
+	void* shared = mmap(nullptr, (jobs+1) * sizeof(std::atomic<unsigned long>), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED)
+		err(-1, "mmap()");
+	auto next = new (shared) std::atomic<unsigned long>(0);
+	for (unsigned int w = 0; w < jobs; w++)
+		new (next+1+w) std::atomic<unsigned long>(NO_JOB);
+
+	int results[2];
+	if (pipe(results))
+		err(-1, "pipe()");
+
+	std::vector<pid_t> pids(jobs, 0);
+	unsigned int running = 0;
+	auto spawn = [&](unsigned int w) {
+		out.flush();
+		pid_t pid = fork();
+		if (pid == -1)
+			err(-1, "fork()");
+		if (!pid) {
+			close(results[0]);
+			worker(lines, *next, next[1+w], results[1], argv0);
+		}
+		pids[w] = pid;
+		running++;
+	};
+	for (unsigned int w = 0; w < jobs && w < lines.size(); w++)
+		spawn(w);
+
+	std::string buffer;
+	auto drain = [&](int timeout) {
+		pollfd p = {results[0], POLLIN, 0};
+		while (poll(&p, 1, timeout) > 0) {
+			char b[4096];
+			ssize_t n = read(results[0], b, sizeof(b));
+			if (n <= 0)
+				break;
+			buffer.append(b, n);
+			auto nl = buffer.rfind('\n');
+			if (nl != std::string::npos) {
+				out << buffer.substr(0, nl+1) << std::flush;
+				buffer.erase(0, nl+1);
+			}
+			timeout = 0;
+		}
+	};
+	while (running) {
+		drain(100);
+		int status;
+		pid_t pid;
+		while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+			auto p = std::find(pids.begin(), pids.end(), pid);
+			if (p == pids.end())
+				continue;
+			unsigned int w = p - pids.begin();
+			running--;
+			drain(0);
+			unsigned long j = next[1+w].exchange(NO_JOB);
+			if (j == NO_JOB)
+				continue;
+			out << "{\"job\":" << j << ",\"status\":\"failed\",\"exit\":" << (WIFEXITED(status) ? WEXITSTATUS(status) : 128+WTERMSIG(status)) << ",\"args\":" << json_string(lines[j]) << "}\n" << std::flush;
+			if (*next < lines.size())
+				spawn(w);
+		}
+	}
+	drain(0);
+
+	if (out.fail())
+		errx(-1, "error writing output");
+	return 0;
+}
+
+/* Each server worker accepts connections itself, so the number of workers
+ * limits the jobs running at once. A connection sends one line of options
+ * and receives the output of the job followed by a JSON line with its
+ * status, its final bound and whether it finished. Closing the connection
+ * cancels the job after its current batch of paths. Threads are handled as
+ * for a batch. */
+[[noreturn]] static void server_worker(int sock, char* argv0) {
+	batch_job = true;
+	batch_threads = cfg::PARALLELISM;
+	batch_pool = std::make_shared<thread_pool>(batch_threads);
+	std::signal(SIGPIPE, SIG_IGN);
+	for (;;) {
+		int c = accept(sock, nullptr, nullptr);
+		if (c == -1) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			err(-1, "accept()");
+		}
+		std::string line;
+		char ch;
+		while (read(c, &ch, 1) == 1 && ch != '\n')
+			line += ch;
+
+		std::istringstream l(line);
+		std::vector<std::string> args;
+		for (std::string arg; l >> arg;)
+			args.push_back(arg);
+		std::vector<char*> argv = {argv0};
+		for (auto& arg: args)
+			argv.push_back(arg.data());
+		argv.push_back(nullptr);
+
+		// without -f the listing follows the options until the client shuts down writing
+		int i = dup(c);
+		int o = dup(c);
+		if (i == -1 || o == -1)
+			err(-1, "dup()");
+		__gnu_cxx::stdio_filebuf<char> ibuf(i, std::ios::in);
+		__gnu_cxx::stdio_filebuf<char> obuf(o, std::ios::out);
+		std::istream is(&ibuf);
+		std::ostream os(&obuf);
+		job_in = &is;
+		job_out = &os;
+
+		std::atomic<bool> finished = false;
+		std::thread watch([c, &finished] {
+			pollfd p = {c, 0, 0};
+			while (!finished) {
+				if (poll(&p, 1, 100) <= 0 || !(p.revents & (POLLHUP | POLLERR)))
+					continue;
+				std::lock_guard guard(running_mutex);
+				if (running)
+					running->cancel();
+				return;
+			}
+		});
+
+		auto begun = std::chrono::steady_clock::now();
+		reset_job();
+		optind = 0;
+		int status = run(argv.size()-1, argv.data());
+		finished = true;
+		watch.join();
+
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begun;
+		os << "{\"status\":\"" << (status ? "failed" : "ok") << "\",\"time\":" << elapsed.count() << ",\"finished\":" << (job_finished ? "true" : "false") << ",\"bound\":" << job_bound << ",\"args\":" << json_string(line) << "}\n" << std::flush;
+		job_in = nullptr;
+		job_out = nullptr;
+		close(c);
+	}
+}
+
+// workers are replaced when a job takes one down
+static int serve(const char* socket, unsigned int jobs, char* argv0) {
+	sockaddr_un addr = {};
+	addr.sun_family = AF_UNIX;
+	if (strlen(socket) >= sizeof(addr.sun_path))
+		errx(-1, "socket path too long: %s", socket);
+	strcpy(addr.sun_path, socket);
+	int sock = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock == -1)
+		err(-1, "socket()");
+	unlink(socket);
+	if (bind(sock, (sockaddr*) &addr, sizeof(addr)))
+		err(-1, "bind(%s)", socket);
+	if (listen(sock, SOMAXCONN))
+		err(-1, "listen(%s)", socket);
+
+	std::vector<pid_t> pids(jobs, 0);
+	auto spawn = [&](unsigned int w) {
+		pid_t pid = fork();
+		if (pid == -1)
+			err(-1, "fork()");
+		if (!pid)
+			server_worker(sock, argv0);
+		pids[w] = pid;
+	};
+	for (unsigned int w = 0; w < jobs; w++)
+		spawn(w);
+
+	for (;;) {
+		int status;
+		pid_t pid = waitpid(-1, &status, 0);
+		if (pid == -1) {
+			if (errno == EINTR)
+				continue;
+			err(-1, "waitpid()");
+		}
+		auto p = std::find(pids.begin(), pids.end(), pid);
+		if (p != pids.end())
+			spawn(p - pids.begin());
+	}
+}
+
+int main(int argc, char** argv) {
+	defaults = new cfg::settings();
+	return run(argc, argv);
+}
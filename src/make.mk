@@ -26,6 +26,10 @@ build: $(BUILD_TARGETS)
 build-clean:
 	rm -rf $(BUILD_DIR)
 
+$(BUILD_DIR)/lib%.a: $$(lib$$*_OBJS)
+	rm -f $@
+	ar rcs $@ $^
+
 $(BUILD_DIR)/%: $(BUILD_DIR)/main_%.o $$($$*_OBJS) $(SRC_DIR)/version.inc.c
 	$(LD) $(LDFLAGS) $($*_LDFLAGS) -o $@ $^ $(LDLIBS) $($*_LDLIBS)
 